@@ -0,0 +1,167 @@
+#include "admit.h"
+#include "metrics.h"
+#include "prng.h"
+
+#include <math.h>
+
+_Static_assert((ADMIT_HOST_SLOTS & (ADMIT_HOST_SLOTS - 1)) == 0,
+               "ADMIT_HOST_SLOTS must be a power of two");
+
+/* Globals */
+unsigned int admit_frame = 0;
+double admit_rate = 1.0;
+
+/* Private state: the reservoir is a min-heap of slot numbers keyed by
+ * the candidates' keys, so the weakest admitted offer is at heap[0] and
+ * displacing it never moves a record */
+static admit_candidate_t slots[ADMIT_RESERVOIR];
+static int heap[ADMIT_RESERVOIR];
+static int heap_count = 0;
+static int heap_limit = ADMIT_RESERVOIR;
+static prng_t admit_rng;
+static double frame_now = 0;
+
+/* Recently seen addresses, direct-mapped by hash: a collision only makes
+ * a host look new once more */
+static struct {
+    uint32_t hash;
+    double last_seen;
+} hosts[ADMIT_HOST_SLOTS];
+
+/* Admission rate window */
+static double window_start = 0;
+static unsigned long window_offered = 0;
+static unsigned long window_admitted = 0;
+
+static const double protocol_weights[TRAFFIC_PROTOS] = ADMIT_PROTOCOL_WEIGHTS;
+
+void admit_seed(uint64_t seed) {
+    prng_seed(&admit_rng, seed);
+}
+
+void admit_begin(double now, int limit) {
+    heap_count = 0;
+    heap_limit = limit < ADMIT_RESERVOIR ? limit : ADMIT_RESERVOIR;
+    frame_now = now;
+    if (++admit_frame == 0) admit_frame = 1;
+}
+
+/* FNV-1a over an address */
+static uint32_t host_hash(const uint8_t *addr) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 16; i++) {
+        h ^= addr[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Mark an address seen; returns 1 if it was not seen recently */
+static int host_touch(const uint8_t *addr) {
+    uint32_t hash = host_hash(addr);
+    unsigned int i = hash & (ADMIT_HOST_SLOTS - 1);
+    int fresh = hosts[i].last_seen == 0 || hosts[i].hash != hash ||
+                frame_now - hosts[i].last_seen > ADMIT_HOST_MEMORY_SEC;
+
+    hosts[i].hash = hash;
+    hosts[i].last_seen = frame_now;
+    return fresh;
+}
+
+int admit_observe(const packet_record_t *rec) {
+    int fresh = host_touch(rec->src);
+    fresh |= host_touch(rec->dst);
+    return fresh ? ADMIT_NEW_HOST : 0;
+}
+
+static double candidate_weight(const packet_record_t *rec, int novelty) {
+    double w = protocol_weights[traffic_protocol(rec)];
+    w *= 1.0 + log2(1.0 + (double)rec->wire_len / ADMIT_BYTES_UNIT);
+    if (novelty & ADMIT_NEW_FLOW) w *= ADMIT_NEW_FLOW_WEIGHT;
+    if (novelty & ADMIT_NEW_HOST) w *= ADMIT_NEW_HOST_WEIGHT;
+    return w;
+}
+
+static void heap_swap(int a, int b) {
+    int t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+}
+
+static void sift_up(int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (slots[heap[parent]].key <= slots[heap[i]].key) break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(int i) {
+    for (;;) {
+        int least = i;
+        int l = 2 * i + 1, r = l + 1;
+        if (l < heap_count && slots[heap[l]].key < slots[heap[least]].key) least = l;
+        if (r < heap_count && slots[heap[r]].key < slots[heap[least]].key) least = r;
+        if (least == i) return;
+        heap_swap(i, least);
+        i = least;
+    }
+}
+
+/* The classic key is u^(1/w); its logarithm orders the same and keeps
+ * its precision for heavy weights */
+void admit_offer(const packet_record_t *rec, int hex, int novelty) {
+    double u = ((prng_next(&admit_rng) >> 11) + 1) * 0x1p-53;   /* (0, 1] */
+    double key = log(u) / candidate_weight(rec, novelty);
+
+    counter_add(&frame_counters.streams_offered, 1);
+    window_offered++;
+
+    if (heap_count < heap_limit) {
+        int slot = heap_count;
+        slots[slot] = (admit_candidate_t){ .rec = *rec, .hex = hex, .key = key };
+        heap[heap_count++] = slot;
+        sift_up(heap_count - 1);
+        return;
+    }
+
+    /* Full: one offer misses out, either this one or the weakest kept */
+    counter_add(&frame_counters.streams_deferred, 1);
+    if (heap_count == 0 || key <= slots[heap[0]].key) return;
+
+    slots[heap[0]] = (admit_candidate_t){ .rec = *rec, .hex = hex, .key = key };
+    sift_down(0);
+}
+
+int admit_select(const admit_candidate_t *picked[ADMIT_RESERVOIR]) {
+    /* Insertion sort by key, heaviest first: the reservoir is small */
+    int n = heap_count;
+    for (int i = 0; i < n; i++) {
+        const admit_candidate_t *c = &slots[heap[i]];
+        int j = i;
+        while (j > 0 && picked[j - 1]->key < c->key) {
+            picked[j] = picked[j - 1];
+            j--;
+        }
+        picked[j] = c;
+    }
+
+    window_admitted += n;
+    if (frame_now - window_start >= ADMIT_RATE_WINDOW_SEC) {
+        admit_rate = window_offered ? (double)window_admitted / window_offered : 1.0;
+        window_start = frame_now;
+        window_offered = 0;
+        window_admitted = 0;
+    }
+    return n;
+}
+
+void admit_print_summary(FILE *f) {
+    unsigned long offered = frame_counters.streams_offered;
+    unsigned long deferred = frame_counters.streams_deferred;
+    if (offered == 0) return;
+
+    fprintf(f, "Admission: %lu of %lu new streams admitted (%.1f%%)\n",
+            offered - deferred, offered, 100.0 * (offered - deferred) / offered);
+}
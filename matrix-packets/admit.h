@@ -0,0 +1,60 @@
+#ifndef ADMIT_H
+#define ADMIT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "capture.h"
+#include "streams.h"
+
+/* Configuration */
+#define ADMIT_RESERVOIR        PACKETS_PER_FRAME  /* new streams admitted per frame */
+#define ADMIT_NEW_FLOW_WEIGHT  4.0   /* weight multiplier for a flow's first packet */
+#define ADMIT_NEW_HOST_WEIGHT  4.0   /* ... for an address not seen recently */
+#define ADMIT_BYTES_UNIT       64    /* volume weight is 1 + log2(1 + bytes / unit) */
+#define ADMIT_PROTOCOL_WEIGHTS { 1.0, 1.0, 2.0, 2.0 }  /* by TRAFFIC_* protocol */
+#define ADMIT_HOST_SLOTS       4096  /* recently seen addresses (power of two) */
+#define ADMIT_HOST_MEMORY_SEC  60.0  /* an address unseen this long is new again */
+#define ADMIT_RATE_WINDOW_SEC  1.0   /* window of the admission rate on screen */
+
+/* Novelty of a record, as passed to admit_offer() */
+#define ADMIT_NEW_FLOW  1
+#define ADMIT_NEW_HOST  2
+
+/* A record that would start a stream, held until the frame's drain ends */
+typedef struct {
+    packet_record_t rec;
+    int hex;                 /* hex stream rather than metadata */
+    double key;              /* A-Res key, log(u) / weight: larger wins */
+} admit_candidate_t;
+
+/* Globals (defined in admit.c) */
+extern unsigned int admit_frame;   /* bumped by admit_begin(), never 0 */
+extern double admit_rate;          /* admitted / offered over the last window */
+
+/* Seed the generator behind the reservoir keys */
+void admit_seed(uint64_t seed);
+
+/* Start a frame's reservoir of at most limit candidates (now in
+ * flow-clock seconds) */
+void admit_begin(double now, int limit);
+
+/* Remember a record's addresses; returns its ADMIT_NEW_HOST bit if
+ * either was not seen within ADMIT_HOST_MEMORY_SEC. Call for every
+ * record so busy hosts stay known. */
+int admit_observe(const packet_record_t *rec);
+
+/* Offer a stream candidate. Weighted reservoir sampling (Efraimidis and
+ * Spirakis' A-Res) keeps the frame's limit of best keys, so every offer
+ * this frame is admitted with probability in proportion to its weight,
+ * however the records were ordered in the rings. */
+void admit_offer(const packet_record_t *rec, int hex, int novelty);
+
+/* End the frame: the admitted candidates, heaviest keys first. Valid
+ * until the next admit_begin(). */
+int admit_select(const admit_candidate_t *picked[ADMIT_RESERVOIR]);
+
+/* Offered and admitted totals for the exit summary */
+void admit_print_summary(FILE *f);
+
+#endif /* ADMIT_H */
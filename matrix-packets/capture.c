@@ -1,31 +1,46 @@
 #define _GNU_SOURCE
 #include "capture.h"
+#include "dissect.h"
+#include "profile.h"
+#include "metrics.h"
+#include "latency.h"
+#include "simulation.h"
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <netinet/tcp.h>
-#include <netinet/udp.h>
-#include <netinet/if_ether.h>
 #include <arpa/inet.h>
 #include <ifaddrs.h>
+#include <net/if.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <signal.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
 
 /* Globals */
-ring_buffer_t ring_buffer;
-pcap_t *pcap_handle = NULL;
-atomic_ulong packets_captured = 0;
-atomic_ulong bytes_per_sec = 0;
-char *net_interface = NULL;
-struct in_addr local_ips[MAX_LOCAL_IPS];
-int local_ip_count = 0;
-
-/* Private state for network rate tracking */
-static unsigned long last_bytes = 0;
-static time_t last_time = 0;
+capture_source_t *capture_sources[MAX_CAPTURE_SOURCES];
+int capture_source_count = 0;
+int capture_backend = CAPTURE_BACKEND_PCAP;
+int adaptive_sampling = 0;
+double replay_speed = 1.0;     /* 0 replays as fast as possible */
+atomic_int capture_done = 0;   /* set once a replay reaches end of file */
+int capture_immediate = 0;     /* pcap immediate mode: deliver without buffering */
+int fanout_workers = 1;        /* capture threads per interface */
+int fanout_mode = CAPTURE_FANOUT_HASH;
+
+/* Wakeups: stop_event_fd tells capture threads to exit; consumer_event_fd
+ * wakes the frame loop while it sleeps with nothing on screen */
+static int stop_event_fd = -1;
+static int consumer_event_fd = -1;
+static atomic_int consumer_sleeping = 0;
+
+/* Private state for fair draining (frame loop only) */
+static int drain_start = 0;
 
 extern volatile sig_atomic_t running;
 
@@ -53,257 +68,911 @@ static int is_encrypted_traffic(uint16_t src_port, uint16_t dst_port) {
     return is_encrypted_port(src_port) || is_encrypted_port(dst_port);
 }
 
+_Static_assert((RING_BUFFER_SIZE & (RING_BUFFER_SIZE - 1)) == 0,
+               "RING_BUFFER_SIZE must be a power of two");
+
+#define RING_MASK (RING_BUFFER_SIZE - 1)
+
 /* Initialize ring buffer */
 void ring_buffer_init(ring_buffer_t *rb) {
     memset(rb, 0, sizeof(*rb));
-    pthread_mutex_init(&rb->lock, NULL);
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->overflows, 0);
 }
 
-/* Push packet to ring buffer (thread-safe) */
-int ring_buffer_push(ring_buffer_t *rb, packet_t *pkt) {
-    pthread_mutex_lock(&rb->lock);
+/* Push record to ring buffer (capture thread only).
+ * Returns -1 and counts an overflow if the consumer has fallen behind. */
+int ring_buffer_push(ring_buffer_t *rb, const packet_record_t *rec) {
+    unsigned int head = atomic_load_explicit(&rb->head, memory_order_relaxed);
 
-    if (rb->count >= RING_BUFFER_SIZE) {
-        rb->tail = (rb->tail + 1) % RING_BUFFER_SIZE;
-        rb->count--;
+    if (head - rb->cached_tail >= RING_BUFFER_SIZE) {
+        rb->cached_tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        if (head - rb->cached_tail >= RING_BUFFER_SIZE) {
+            atomic_fetch_add_explicit(&rb->overflows, 1, memory_order_relaxed);
+            return -1;
+        }
     }
 
-    memcpy(&rb->packets[rb->head], pkt, sizeof(packet_t));
-    rb->head = (rb->head + 1) % RING_BUFFER_SIZE;
-    rb->count++;
-
-    pthread_mutex_unlock(&rb->lock);
+    memcpy(&rb->records[head & RING_MASK], rec, sizeof(*rec));
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);
     return 0;
 }
 
-/* Pop packet from ring buffer (thread-safe) */
-int ring_buffer_pop(ring_buffer_t *rb, packet_t *pkt) {
-    pthread_mutex_lock(&rb->lock);
+/* Drain up to max records in place (frame loop only), stopping early at
+ * one queued after until_us. The tail is published once for the whole
+ * batch. Returns the count. */
+int ring_buffer_drain(ring_buffer_t *rb, ring_drain_fn fn, void *ctx, int max,
+                      uint64_t until_us) {
+    unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
 
-    if (rb->count == 0) {
-        pthread_mutex_unlock(&rb->lock);
-        return -1;
+    if (rb->cached_head == tail) {
+        rb->cached_head = atomic_load_explicit(&rb->head, memory_order_acquire);
     }
 
-    memcpy(pkt, &rb->packets[rb->tail], sizeof(*pkt));
-    rb->tail = (rb->tail + 1) % RING_BUFFER_SIZE;
-    rb->count--;
+    unsigned int avail = rb->cached_head - tail;
+    unsigned int n = avail < (unsigned int)max ? avail : (unsigned int)max;
 
-    pthread_mutex_unlock(&rb->lock);
-    return 0;
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        const packet_record_t *rec = &rb->records[(tail + i) & RING_MASK];
+        if (rec->queued_us > until_us) break;
+        fn(rec, ctx);
+    }
+    n = i;
+
+    if (n > 0) {
+        atomic_store_explicit(&rb->tail, tail + n, memory_order_release);
+    }
+    return (int)n;
+}
+
+/* Approximate number of queued records (safe from either side) */
+unsigned int ring_buffer_count(ring_buffer_t *rb) {
+    unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    unsigned int head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    return head - tail;
 }
 
-/* Format packet info with per-character colors */
-static void format_packet_info(packet_t *pkt, const struct ip *ip_hdr, int protocol,
-                               uint16_t src_port, uint16_t dst_port) {
-    char src_ip[INET_ADDRSTRLEN];
-    char dst_ip[INET_ADDRSTRLEN];
-    const char *proto_str;
-    int pos = 0;
+/* TRAFFIC_* protocol bucket of a record */
+int traffic_protocol(const packet_record_t *rec) {
+    if (rec->kind == PKT_KIND_ARP) return TRAFFIC_OTHER;
 
-    inet_ntop(AF_INET, &ip_hdr->ip_src, src_ip, sizeof(src_ip));
-    inet_ntop(AF_INET, &ip_hdr->ip_dst, dst_ip, sizeof(dst_ip));
+    switch (rec->protocol) {
+        case IPPROTO_TCP:    return TRAFFIC_TCP;
+        case IPPROTO_UDP:    return TRAFFIC_UDP;
+        case IPPROTO_ICMP:
+        case IPPROTO_ICMPV6: return TRAFFIC_ICMP;
+        default:             return TRAFFIC_OTHER;
+    }
+}
 
-    int is_inbound = is_local_ip(ip_hdr->ip_dst);
-    pkt->is_inbound = is_inbound;
+/* Add a dissected packet to its direction/protocol bucket. Each packet
+ * that passed a 1-in-N sampling filter stands for N packets. */
+static void count_traffic(capture_source_t *src, const packet_record_t *rec, uint32_t wire_len) {
+    traffic_counter_t *c = &src->traffic[rec->is_inbound ? TRAFFIC_IN : TRAFFIC_OUT]
+                                        [traffic_protocol(rec)];
+    unsigned long scale = atomic_load_explicit(&src->sample_rate, memory_order_relaxed);
 
-    int stream_color = is_inbound ? COLOR_INBOUND : COLOR_OUTBOUND;
+    counter_add(&c->packets, scale);
+    counter_add(&c->bytes, wire_len * scale);
+}
 
-    switch (protocol) {
-        case IPPROTO_TCP: proto_str = "TCP"; break;
-        case IPPROTO_UDP: proto_str = "UDP"; break;
-        case IPPROTO_ICMP: proto_str = "ICMP"; break;
-        default: proto_str = "IP"; break;
+/* pcap callback (also driven by the TPACKET_V3 ring walker) */
+void packet_handler(u_char *user, const struct pcap_pkthdr *header, const u_char *packet) {
+    capture_source_t *src = (capture_source_t *)user;
+    packet_record_t rec;
+    const u_char *payload;
+    uint32_t payload_len;
+    int rc;
+
+    counter_add(&src->packets, 1);
+
+    if (profiling) {
+        uint64_t start = profile_ticks();
+        rc = dissect_packet(src->linktype, packet, header->caplen, &rec, &payload, &payload_len);
+        src->dissect_ticks += profile_ticks() - start;
+        src->dissect_calls++;
+    } else {
+        rc = dissect_packet(src->linktype, packet, header->caplen, &rec, &payload, &payload_len);
+    }
+    if (rc != 0) {
+        counter_add(&src->filtered, 1);
+        return;
     }
 
-    /* Protocol */
-    int proto_len = strlen(proto_str);
-    for (int i = 0; i < proto_len && pos < MAX_INFO_LEN - 1; i++) {
-        pkt->text[pos] = proto_str[i];
-        pkt->colors[pos] = stream_color;
-        pos++;
+    int family = rec.kind == PKT_KIND_IPV6 ? AF_INET6 : AF_INET;
+    rec.is_inbound = is_local_addr(src, family, rec.dst);
+    rec.is_encrypted = is_encrypted_traffic(rec.src_port, rec.dst_port);
+    rec.payload_len = 0;
+    rec.wire_len = header->len;
+    rec.captured_us = src->backend == CAPTURE_BACKEND_FILE ? 0
+                    : (uint64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec;
+    rec.queued_us = src->batch_us;
+
+    count_traffic(src, &rec, header->len);
+
+    /* Keep only the payload prefix a hex stream can display */
+    if (rec.is_encrypted && payload) {
+        if (payload_len > HEX_PAYLOAD_MAX) payload_len = HEX_PAYLOAD_MAX;
+        memcpy(rec.payload, payload, payload_len);
+        rec.payload_len = payload_len;
     }
 
-    if (pos < MAX_INFO_LEN - 1) {
-        pkt->text[pos] = ' ';
-        pkt->colors[pos] = stream_color;
-        pos++;
+    ring_buffer_push(&src->ring, &rec);
+}
+
+/* Filters to try, most specific first: not every link type supports the
+ * "arp" or "vlan" primitives, so take the first that compiles */
+static const char *const capture_filters[] = {
+    "ip or ip6 or arp or vlan",
+    "ip or ip6 or arp",
+    "ip or ip6",
+};
+
+#define CAPTURE_FILTER_COUNT (sizeof(capture_filters) / sizeof(capture_filters[0]))
+
+/* Compile the capture filter for a link type. When rate > 1 the program
+ * is prefixed with a random-sampling clause so the kernel keeps roughly
+ * one packet in rate:
+ *     ld  rand
+ *     jgt #(2^32 / rate), drop, filter
+ *     drop: ret #0
+ *     filter: <compiled capture filter> */
+int capture_compile_filter(int linktype, unsigned int rate, struct bpf_program *prog) {
+    pcap_t *dead = pcap_open_dead(linktype, CAPTURE_SNAPLEN);
+    if (!dead) return -1;
+
+    int rc = -1;
+    for (size_t i = 0; i < CAPTURE_FILTER_COUNT && rc != 0; i++) {
+        rc = pcap_compile(dead, prog, capture_filters[i], 1, PCAP_NETMASK_UNKNOWN);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "pcap_compile: %s\n", pcap_geterr(dead));
     }
+    pcap_close(dead);
+    if (rc != 0) return -1;
+
+    if (rate <= 1) return 0;
 
-    /* Source IP */
-    int src_len = strlen(src_ip);
-    for (int i = 0; i < src_len && pos < MAX_INFO_LEN - 1; i++) {
-        pkt->text[pos] = src_ip[i];
-        pkt->colors[pos] = stream_color;
-        pos++;
+    /* pcap_freecode() frees bf_insns, so build the prefixed copy with malloc */
+    struct bpf_insn *insns = malloc((prog->bf_len + 3) * sizeof(*insns));
+    if (!insns) {
+        pcap_freecode(prog);
+        return -1;
     }
 
-    /* Source port */
-    if (src_port > 0) {
-        if (pos < MAX_INFO_LEN - 1) {
-            pkt->text[pos] = ':';
-            pkt->colors[pos] = stream_color;
-            pos++;
+    insns[0] = (struct bpf_insn){ BPF_LD | BPF_W | BPF_ABS, 0, 0,
+                                  (uint32_t)(SKF_AD_OFF + SKF_AD_RANDOM) };
+    insns[1] = (struct bpf_insn){ BPF_JMP | BPF_JGT | BPF_K, 0, 1,
+                                  (uint32_t)(0xffffffffu / rate) };
+    insns[2] = (struct bpf_insn){ BPF_RET | BPF_K, 0, 0, 0 };
+    memcpy(&insns[3], prog->bf_insns, prog->bf_len * sizeof(*insns));
+
+    unsigned int len = prog->bf_len + 3;
+    pcap_freecode(prog);
+    prog->bf_insns = insns;
+    prog->bf_len = len;
+    return 0;
+}
+
+/* Whether the kernel runs a program of len instructions on the socket.
+ * libpcap quietly filters in userland when the kernel refuses a program,
+ * and its interpreter reads SKF_AD_RANDOM as out of range: a sampling
+ * prefix would then drop every packet. */
+static int kernel_runs_filter(int fd, unsigned int len) {
+    socklen_t attached = 0;   /* a zero length asks for the instruction count */
+    if (getsockopt(fd, SOL_SOCKET, SO_GET_FILTER, NULL, &attached) != 0) return 0;
+    return attached == len;
+}
+
+/* Install a new sampling rate on a source's backend. On the pcap backend
+ * only Ethernet links sample: libpcap rewrites programs for cooked (SLL)
+ * captures and may run them in userland instead. */
+static void apply_sample_rate(capture_source_t *src, unsigned int rate) {
+    struct bpf_program prog;
+    char errbuf[PCAP_ERRBUF_SIZE];
+
+    if (rate > 1 && (src->sampling_refused ||
+                     (src->backend == CAPTURE_BACKEND_PCAP && src->linktype != DLT_EN10MB))) {
+        return;
+    }
+    if (capture_compile_filter(src->linktype, rate, &prog) != 0) return;
+
+    int rc;
+    if (src->backend == CAPTURE_BACKEND_TPACKET) {
+        rc = tpacket_set_filter(&src->tpacket, &prog, errbuf);
+    } else {
+        rc = pcap_setfilter(src->pcap, &prog);
+        if (rc == 0 && rate > 1 && !kernel_runs_filter(pcap_fileno(src->pcap), prog.bf_len)) {
+            /* Put the plain filter back rather than drop everything, and
+             * stop trying: each pcap_setfilter() flushes the socket */
+            src->sampling_refused = 1;
+            pcap_freecode(&prog);
+            if (capture_compile_filter(src->linktype, 1, &prog) != 0) return;
+            if (pcap_setfilter(src->pcap, &prog) == 0) rate = 1;
+            else rc = -1;
         }
-        char port_str[8];
-        snprintf(port_str, sizeof(port_str), "%u", src_port);
-        int port_len = strlen(port_str);
-        for (int i = 0; i < port_len && pos < MAX_INFO_LEN - 1; i++) {
-            pkt->text[pos] = port_str[i];
-            pkt->colors[pos] = stream_color;
-            pos++;
+    }
+    pcap_freecode(&prog);
+
+    if (rc == 0) {
+        atomic_store(&src->sample_rate, rate);
+    }
+}
+
+/* Tighten sampling while the ring stays saturated, relax it when the
+ * frame loop drains faster than packets arrive */
+static void adapt_sampling(capture_source_t *src) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    long elapsed_ms = (now.tv_sec - src->sampling_checked.tv_sec) * 1000
+                    + (now.tv_nsec - src->sampling_checked.tv_nsec) / 1000000;
+    if (elapsed_ms < SAMPLING_INTERVAL_MS) return;
+    src->sampling_checked = now;
+
+    unsigned long overflows = src->ring.overflows;
+    unsigned int queued = ring_buffer_count(&src->ring);
+    unsigned int rate = atomic_load(&src->sample_rate);
+    unsigned int next = rate;
+
+    if (overflows != src->sampling_overflows || queued >= SAMPLING_HIGH_WATER) {
+        if (rate < SAMPLING_RATE_MAX) next = rate * 2;
+    } else if (queued <= SAMPLING_LOW_WATER && rate > 1) {
+        next = rate / 2;
+    }
+    src->sampling_overflows = overflows;
+
+    if (next != rate) {
+        apply_sample_rate(src, next);
+    }
+}
+
+/* Fold the backend's kernel drop counter into src->kernel_drops. Only the
+ * thread that owns the handle may call this (or anyone once it stopped):
+ * libpcap handles are not thread-safe and TPACKET stats reset on read. */
+static void refresh_kernel_stats(capture_source_t *src) {
+    if (src->backend == CAPTURE_BACKEND_TPACKET) {
+        tpacket_stats_t st;
+        if (tpacket_get_stats(&src->tpacket, &st) == 0) {
+            counter_add(&src->kernel_drops, st.drops);
+        }
+    } else if (src->backend == CAPTURE_BACKEND_PCAP && src->pcap) {
+        struct pcap_stat st;
+        if (pcap_stats(src->pcap, &st) == 0) {
+            atomic_store_explicit(&src->kernel_drops, st.ps_drop, memory_order_relaxed);
         }
     }
+}
+
+/* Refresh kernel stats at most once per METRICS_INTERVAL_MS while exporting */
+static void maybe_refresh_kernel_stats(capture_source_t *src) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
 
-    /* Arrow */
-    const char *arrow = " > ";
-    for (int i = 0; arrow[i] && pos < MAX_INFO_LEN - 1; i++) {
-        pkt->text[pos] = arrow[i];
-        pkt->colors[pos] = stream_color;
-        pos++;
+    long elapsed_ms = (now.tv_sec - src->stats_checked.tv_sec) * 1000
+                    + (now.tv_nsec - src->stats_checked.tv_nsec) / 1000000;
+    if (elapsed_ms < METRICS_INTERVAL_MS) return;
+    src->stats_checked = now;
+    refresh_kernel_stats(src);
+}
+
+/* Wake the frame loop if it went to sleep waiting for packets. Called
+ * once per batch, so a busy link costs one atomic load per batch. */
+static void notify_consumer(void) {
+    if (atomic_load_explicit(&consumer_sleeping, memory_order_acquire) &&
+        atomic_exchange(&consumer_sleeping, 0)) {
+        uint64_t one = 1;
+        if (write(consumer_event_fd, &one, sizeof(one)) < 0) {
+            /* Counter already non-zero; the frame loop is waking anyway */
+        }
     }
+}
 
-    /* Destination IP */
-    int dst_len = strlen(dst_ip);
-    for (int i = 0; i < dst_len && pos < MAX_INFO_LEN - 1; i++) {
-        pkt->text[pos] = dst_ip[i];
-        pkt->colors[pos] = stream_color;
-        pos++;
+/* Sleep until an absolute CLOCK_MONOTONIC deadline, waking periodically
+ * to notice shutdown */
+static void sleep_until(const struct timespec *due) {
+    while (running) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long remaining_ms = (due->tv_sec - now.tv_sec) * 1000
+                          + (due->tv_nsec - now.tv_nsec) / 1000000;
+        if (remaining_ms <= REPLAY_MAX_SLEEP_MS) {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, due, NULL);
+            return;
+        }
+        struct timespec step = { 0, REPLAY_MAX_SLEEP_MS * 1000000L };
+        nanosleep(&step, NULL);
     }
+}
 
-    /* Destination port */
-    if (dst_port > 0) {
-        if (pos < MAX_INFO_LEN - 1) {
-            pkt->text[pos] = ':';
-            pkt->colors[pos] = stream_color;
-            pos++;
+/* Replay an offline capture through packet_handler(), spacing packets by
+ * their pcap timestamps divided by replay_speed. A simulation instead
+ * stamps records with their own timestamps and lets the frame loop's
+ * clock set the pace. */
+static void replay_capture(capture_source_t *src) {
+    struct pcap_pkthdr *hdr;
+    const u_char *data;
+    struct timespec wall_start;
+    struct timeval first_ts;
+    int have_first = 0;
+    int rc;
+
+    while (running && (rc = pcap_next_ex(src->pcap, &hdr, &data)) >= 0) {
+        if (rc == 0) continue;
+
+        if (simulation) {
+            /* Never drop a record: wait for the frame loop to make room */
+            uint64_t ts_us = (uint64_t)hdr->ts.tv_sec * 1000000 + hdr->ts.tv_usec;
+            while (running && ring_buffer_count(&src->ring) >= RING_BUFFER_SIZE) {
+                simulation_pause();
+            }
+            src->batch_us = ts_us;
+            packet_handler((u_char *)src, hdr, data);
+            atomic_store_explicit(&src->replay_clock_us, ts_us, memory_order_release);
+            continue;
         }
-        char port_str[8];
-        snprintf(port_str, sizeof(port_str), "%u", dst_port);
-        int port_len = strlen(port_str);
-        for (int i = 0; i < port_len && pos < MAX_INFO_LEN - 1; i++) {
-            pkt->text[pos] = port_str[i];
-            pkt->colors[pos] = stream_color;
-            pos++;
+
+        if (replay_speed > 0) {
+            if (!have_first) {
+                first_ts = hdr->ts;
+                clock_gettime(CLOCK_MONOTONIC, &wall_start);
+                have_first = 1;
+            } else {
+                double offset = ((hdr->ts.tv_sec - first_ts.tv_sec)
+                              + (hdr->ts.tv_usec - first_ts.tv_usec) / 1e6) / replay_speed;
+                if (offset > 0) {
+                    struct timespec due = wall_start;
+                    due.tv_sec  += (time_t)offset;
+                    due.tv_nsec += (long)((offset - (time_t)offset) * 1e9);
+                    if (due.tv_nsec >= 1000000000L) {
+                        due.tv_sec++;
+                        due.tv_nsec -= 1000000000L;
+                    }
+                    sleep_until(&due);
+                }
+            }
         }
+
+        src->batch_us = latency_now_us();
+        packet_handler((u_char *)src, hdr, data);
+        notify_consumer();
     }
 
-    pkt->is_encrypted = is_encrypted_traffic(src_port, dst_port);
-    pkt->column_zone = pkt->is_encrypted ? ZONE_ENCRYPTED_META : ZONE_CLEARTEXT;
+    if (running && rc == PCAP_ERROR) {
+        fprintf(stderr, "Replay stopped: %s\n", pcap_geterr(src->pcap));
+    }
+    capture_done = 1;
+    notify_consumer();
+}
 
-    pkt->text[pos] = '\0';
-    pkt->length = pos;
+/* Block until the source's fd is readable, capture_stop() is called, or
+ * timeout_ms passes (-1 waits indefinitely) */
+static void wait_for_packets(capture_source_t *src, int timeout_ms) {
+    struct epoll_event ev;
+    epoll_wait(src->epoll_fd, &ev, 1, timeout_ms);
 }
 
-/* pcap callback */
-static void packet_handler(u_char *user, const struct pcap_pkthdr *header, const u_char *packet) {
-    (void)user;
+/* Set up the epoll set a live capture thread sleeps on */
+static int watch_capture_fd(capture_source_t *src) {
+    int fd = src->backend == CAPTURE_BACKEND_TPACKET
+           ? src->tpacket.fd : pcap_get_selectable_fd(src->pcap);
+    if (fd < 0) {
+        fprintf(stderr, "%s: no selectable fd\n", src->name);
+        return -1;
+    }
 
-    packets_captured++;
+    src->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (src->epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = fd;
+    if (epoll_ctl(src->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    ev.data.fd = stop_event_fd;
+    if (epoll_ctl(src->epoll_fd, EPOLL_CTL_ADD, stop_event_fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+/* Packet capture thread (one per source) */
+void *capture_thread(void *arg) {
+    capture_source_t *src = arg;
+
+    if (src->backend == CAPTURE_BACKEND_FILE) {
+        replay_capture(src);
+        return NULL;
+    }
+
+    /* Sleep until the kernel has data; wake periodically only when
+     * adaptive sampling or the metrics export need to look around */
+    int timeout_ms = -1;
+    if (adaptive_sampling) timeout_ms = SAMPLING_INTERVAL_MS;
+    if (metrics_path && (timeout_ms < 0 || timeout_ms > METRICS_INTERVAL_MS)) {
+        timeout_ms = METRICS_INTERVAL_MS;
+    }
+
+    while (running) {
+        wait_for_packets(src, timeout_ms);
+
+        /* Drain everything that is ready, then notify once. One clock
+         * read per batch stamps when its records were queued. */
+        int total = 0, n;
+        while (running) {
+            src->batch_us = latency_now_us();
+            n = src->backend == CAPTURE_BACKEND_TPACKET
+              ? tpacket_dispatch(&src->tpacket, packet_handler, (u_char *)src)
+              : pcap_dispatch(src->pcap, PCAP_BATCH_SIZE, packet_handler, (u_char *)src);
+            if (n <= 0) break;
+            total += n;
+        }
+        if (total > 0) notify_consumer();
 
-    if (header->caplen < sizeof(struct ether_header)) return;
+        if (adaptive_sampling) adapt_sampling(src);
+        if (metrics_path) maybe_refresh_kernel_stats(src);
+    }
 
-    const struct ether_header *eth = (struct ether_header *)packet;
-    if (ntohs(eth->ether_type) != ETHERTYPE_IP) return;
+    return NULL;
+}
 
-    if (header->caplen < sizeof(struct ether_header) + 20) return;
+const char *capture_backend_name(int backend) {
+    switch (backend) {
+        case CAPTURE_BACKEND_TPACKET: return "tpacket";
+        case CAPTURE_BACKEND_FILE:    return "file";
+        default:                      return "pcap";
+    }
+}
 
-    const struct ip *ip_hdr = (struct ip *)(packet + sizeof(struct ether_header));
-    int ip_header_len = ip_hdr->ip_hl * 4;
+/* Allocate a source; the ring needs cache-line alignment */
+capture_source_t *capture_add_source(const char *name) {
+    if (capture_source_count >= MAX_CAPTURE_SOURCES) return NULL;
 
-    if (ip_header_len < 20) return;
-    if (header->caplen < sizeof(struct ether_header) + (unsigned)ip_header_len) return;
+    size_t size = (sizeof(capture_source_t) + CACHE_LINE_SIZE - 1)
+                & ~(size_t)(CACHE_LINE_SIZE - 1);
+    capture_source_t *src = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (!src) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    memset(src, 0, sizeof(*src));
+
+    ring_buffer_init(&src->ring);
+    snprintf(src->name, sizeof(src->name), "%s", name);
+    snprintf(src->label, sizeof(src->label), "%s", name);
+    src->backend = capture_backend;
+    src->tpacket.fd = -1;
+    src->epoll_fd = -1;
+    atomic_init(&src->packets, 0);
+    atomic_init(&src->filtered, 0);
+    atomic_init(&src->kernel_drops, 0);
+    atomic_init(&src->bytes_per_sec, 0);
+    atomic_init(&src->sample_rate, 1);
+    atomic_init(&src->replay_clock_us, 0);
+
+    capture_sources[capture_source_count++] = src;
+    return src;
+}
 
-    int protocol = ip_hdr->ip_p;
+/* Fanout group shared by every worker on an interface. Group ids are
+ * global to the host, so mix in the pid to stay out of other captures. */
+static int fanout_group(const char *interface) {
+    return (int)((getpid() * 31u + if_nametoindex(interface)) & 0xffff);
+}
 
-    uint16_t src_port = 0, dst_port = 0;
-    int transport_header_len = 0;
+/* Join a PACKET_FANOUT group so the kernel spreads the interface's
+ * packets over the workers' sockets */
+static int join_fanout(capture_source_t *src, int fd, char *errbuf) {
+    int mode = fanout_mode == CAPTURE_FANOUT_CPU ? PACKET_FANOUT_CPU
+                                                 : PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+    int arg = fanout_group(src->name) | (mode << 16);
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_FANOUT: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
 
-    if (protocol == IPPROTO_TCP) {
-        if (header->caplen >= sizeof(struct ether_header) + (unsigned)ip_header_len + 20) {
-            const struct tcphdr *tcp = (struct tcphdr *)((unsigned char *)ip_hdr + ip_header_len);
-            src_port = ntohs(tcp->th_sport);
-            dst_port = ntohs(tcp->th_dport);
-            transport_header_len = tcp->th_off * 4;
-            if (transport_header_len < 20) transport_header_len = 20;
+/* Open a live interface with the requested backend, falling back to
+ * libpcap if the TPACKET_V3 ring cannot be set up. Worker sources
+ * (fanout_workers > 1) also join the interface's fanout group. */
+int capture_open_live(capture_source_t *src, char *errbuf) {
+    if (src->backend == CAPTURE_BACKEND_TPACKET) {
+        struct bpf_program fp;
+        int rc = -1;
+        src->linktype = tpacket_linktype(src->name);
+        if (src->linktype < 0) {
+            snprintf(errbuf, PCAP_ERRBUF_SIZE, "unsupported link type");
+        } else if (capture_compile_filter(src->linktype, 1, &fp) == 0) {
+            rc = tpacket_open(&src->tpacket, src->name, &fp, errbuf);
+            pcap_freecode(&fp);
+        } else {
+            snprintf(errbuf, PCAP_ERRBUF_SIZE, "could not compile filter");
         }
-    } else if (protocol == IPPROTO_UDP) {
-        if (header->caplen >= sizeof(struct ether_header) + (unsigned)ip_header_len + 8) {
-            const struct udphdr *udp = (struct udphdr *)((unsigned char *)ip_hdr + ip_header_len);
-            src_port = ntohs(udp->uh_sport);
-            dst_port = ntohs(udp->uh_dport);
-            transport_header_len = 8;
+        if (rc == 0) {
+            if (fanout_workers > 1 && join_fanout(src, src->tpacket.fd, errbuf) != 0) {
+                return -1;
+            }
+            return 0;
         }
+
+        fprintf(stderr, "%s: TPACKET_V3 backend unavailable: %s\n", src->name, errbuf);
+        fprintf(stderr, "%s: falling back to libpcap\n", src->name);
+        src->backend = CAPTURE_BACKEND_PCAP;
     }
 
-    const u_char *payload = NULL;
-    int payload_len = 0;
-    int headers_len = sizeof(struct ether_header) + ip_header_len + transport_header_len;
-    if (transport_header_len > 0 && (int)header->caplen > headers_len) {
-        payload = packet + headers_len;
-        payload_len = header->caplen - headers_len;
+    src->pcap = pcap_create(src->name, errbuf);
+    if (!src->pcap) return -1;
+
+    pcap_set_snaplen(src->pcap, CAPTURE_SNAPLEN);
+    pcap_set_promisc(src->pcap, 0);
+    pcap_set_timeout(src->pcap, PCAP_TIMEOUT_MS);
+    if (capture_immediate) {
+        pcap_set_immediate_mode(src->pcap, 1);
     }
 
-    packet_t pkt;
-    pkt.length = 0;
-    pkt.is_encrypted = 0;
-    pkt.is_inbound = 0;
-    pkt.column_zone = 0;
-    format_packet_info(&pkt, ip_hdr, protocol, src_port, dst_port);
+    int status = pcap_activate(src->pcap);
+    if (status < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(src->pcap));
+        pcap_close(src->pcap);
+        src->pcap = NULL;
+        return -1;
+    }
+    if (status > 0) {
+        fprintf(stderr, "%s: %s\n", src->name, pcap_statustostr(status));
+    }
 
-    if (pkt.length > 0) {
-        ring_buffer_push(&ring_buffer, &pkt);
+    /* libpcap's Linux capture socket is an AF_PACKET socket too */
+    if (fanout_workers > 1 && join_fanout(src, pcap_fileno(src->pcap), errbuf) != 0) {
+        return -1;
     }
 
-    /* For encrypted traffic with payload, push a separate hex-only packet */
-    if (pkt.is_encrypted && payload && payload_len >= MIN_PACKET_DISPLAY) {
-        packet_t hex_pkt;
-        hex_pkt.is_encrypted = 1;
-        hex_pkt.is_inbound = pkt.is_inbound;
-        hex_pkt.column_zone = ZONE_ENCRYPTED_HEX;
+    src->linktype = pcap_datalink(src->pcap);
+    if (!dissect_supports(src->linktype)) {
+        fprintf(stderr, "Warning: %s has an unsupported link type; "
+                "packets will be skipped\n", src->name);
+    }
 
-        int pos = 0;
-        static const char hexchars[] = "0123456789abcdef";
-        int max_pos = MAX_INFO_LEN - 2;
+    /* Apply BPF filter */
+    struct bpf_program fp;
+    if (capture_compile_filter(src->linktype, 1, &fp) == 0) {
+        pcap_setfilter(src->pcap, &fp);
+        pcap_freecode(&fp);
+    }
 
-        int hex_color = pkt.is_inbound ? COLOR_INBOUND : COLOR_OUTBOUND;
-        for (int i = 0; i < payload_len && pos < max_pos; i++) {
-            if (i > 0 && pos < max_pos) {
-                hex_pkt.text[pos] = ' ';
-                hex_pkt.colors[pos] = hex_color;
-                pos++;
-            }
-            if (pos + 1 < max_pos) {
-                hex_pkt.text[pos] = hexchars[(payload[i] >> 4) & 0x0f];
-                hex_pkt.colors[pos] = hex_color;
-                pos++;
-                hex_pkt.text[pos] = hexchars[payload[i] & 0x0f];
-                hex_pkt.colors[pos] = hex_color;
-                pos++;
-            }
+    /* Set non-blocking mode */
+    char nb_errbuf[PCAP_ERRBUF_SIZE];
+    if (pcap_setnonblock(src->pcap, 1, nb_errbuf) < 0) {
+        fprintf(stderr, "%s: could not set non-blocking mode: %s\n", src->name, nb_errbuf);
+    }
+    return 0;
+}
+
+/* Open a pcap/pcapng file (or "-" for stdin) for replay */
+int capture_open_file(capture_source_t *src, char *errbuf) {
+    src->backend = CAPTURE_BACKEND_FILE;
+    src->pcap = pcap_open_offline(src->name, errbuf);
+    if (!src->pcap) return -1;
+
+    src->linktype = pcap_datalink(src->pcap);
+    if (!dissect_supports(src->linktype)) {
+        fprintf(stderr, "Warning: %s has an unsupported link type; "
+                "packets will be skipped\n", src->name);
+    }
+
+    struct bpf_program fp;
+    if (capture_compile_filter(src->linktype, 1, &fp) == 0) {
+        pcap_setfilter(src->pcap, &fp);
+        pcap_freecode(&fp);
+    }
+    return 0;
+}
+
+/* Start one capture thread per source */
+int capture_start(void) {
+    stop_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    consumer_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_event_fd < 0 || consumer_event_fd < 0) {
+        perror("eventfd");
+        return -1;
+    }
+
+    for (int i = 0; i < capture_source_count; i++) {
+        capture_source_t *src = capture_sources[i];
+        if (src->backend != CAPTURE_BACKEND_FILE) {
+            if (watch_capture_fd(src) != 0) return -1;
+            read_interface_bytes(src->name, &src->proc_start_bytes);
         }
+        clock_gettime(CLOCK_MONOTONIC, &src->rate_checked);
+        if (pthread_create(&src->thread, NULL, capture_thread, src) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+        src->thread_started = 1;
+    }
+    return 0;
+}
 
-        hex_pkt.text[pos] = '\0';
-        hex_pkt.length = pos;
+/* Join capture threads (running must already be cleared) */
+void capture_stop(void) {
+    if (stop_event_fd >= 0) {
+        uint64_t one = 1;
+        if (write(stop_event_fd, &one, sizeof(one)) < 0) {
+            perror("write stop event");
+        }
+    }
 
-        if (hex_pkt.length > 0) {
-            ring_buffer_push(&ring_buffer, &hex_pkt);
+    for (int i = 0; i < capture_source_count; i++) {
+        capture_source_t *src = capture_sources[i];
+        if (src->thread_started) {
+            pthread_join(src->thread, NULL);
+            src->thread_started = 0;
         }
     }
 }
 
-/* Packet capture thread */
-void *capture_thread(void *arg) {
-    (void)arg;
+/* Close every source and free it */
+void capture_close(void) {
+    for (int i = 0; i < capture_source_count; i++) {
+        capture_source_t *src = capture_sources[i];
+        if (src->pcap) {
+            pcap_close(src->pcap);
+        }
+        tpacket_close(&src->tpacket);
+        if (src->epoll_fd >= 0) {
+            close(src->epoll_fd);
+        }
+        free(src);
+        capture_sources[i] = NULL;
+    }
+    capture_source_count = 0;
 
-    while (running) {
-        int n = pcap_dispatch(pcap_handle, PCAP_BATCH_SIZE, packet_handler, NULL);
-        if (n == 0) {
-            usleep(CAPTURE_IDLE_US);
+    if (stop_event_fd >= 0) {
+        close(stop_event_fd);
+        stop_event_fd = -1;
+    }
+    if (consumer_event_fd >= 0) {
+        close(consumer_event_fd);
+        consumer_event_fd = -1;
+    }
+}
+
+/* Timestamp of the replay's first record, waiting for it to be queued
+ * (0 if the replay holds none) */
+uint64_t capture_replay_start(void) {
+    capture_source_t *src = capture_sources[0];
+    while (running && !capture_done && ring_buffer_count(&src->ring) == 0) {
+        simulation_pause();
+    }
+    if (ring_buffer_count(&src->ring) == 0) return 0;
+
+    unsigned int tail = atomic_load_explicit(&src->ring.tail, memory_order_relaxed);
+    return src->ring.records[tail & RING_MASK].queued_us;
+}
+
+/* Wait until the replay has queued every record stamped up to until_us,
+ * so a frame drains the same records on every run. A full ring counts:
+ * the replay is then blocked on the frame loop. */
+void capture_sync_replay(uint64_t until_us) {
+    capture_source_t *src = capture_sources[0];
+    while (running && !capture_done &&
+           atomic_load_explicit(&src->replay_clock_us, memory_order_acquire) <= until_us &&
+           ring_buffer_count(&src->ring) < RING_BUFFER_SIZE) {
+        simulation_pause();
+    }
+}
+
+/* fd the frame loop polls to learn that packets arrived while it slept */
+int capture_event_fd(void) {
+    return consumer_event_fd;
+}
+
+/* Reset the eventfd. A capture thread that saw the flag just before it
+ * was cleared may still write after the frame loop stopped listening,
+ * so the count is dropped whenever a sleep ends or is abandoned. */
+static void drain_consumer_event(void) {
+    uint64_t count;
+    if (read(consumer_event_fd, &count, sizeof(count)) < 0) {
+        /* EAGAIN: nothing was written */
+    }
+}
+
+/* Announce that the frame loop is about to sleep until packets arrive.
+ * Returns 0 (and stays awake) if records are already queued or a replay
+ * has finished, so a wakeup can never be lost between check and sleep. */
+int capture_prepare_sleep(void) {
+    atomic_store(&consumer_sleeping, 1);
+    if (capture_queued() > 0 || capture_done) {
+        atomic_store(&consumer_sleeping, 0);
+        drain_consumer_event();
+        return 0;
+    }
+    return 1;
+}
+
+/* Called after the frame loop wakes: clear the flag and the eventfd */
+void capture_finish_sleep(void) {
+    atomic_store(&consumer_sleeping, 0);
+    drain_consumer_event();
+}
+
+/* Drain the source rings in rotating order. Each source is offered an
+ * equal share of what is left of max; a source with less queued leaves
+ * its unused share to the ones after it, so one busy interface cannot
+ * starve a quiet one and no budget is wasted. */
+int capture_drain(ring_drain_fn fn, void *ctx, int max, uint64_t until_us) {
+    int n = capture_source_count;
+    int total = 0;
+    if (n == 0) return 0;
+
+    for (int k = 0; k < n && total < max; k++) {
+        capture_source_t *src = capture_sources[(drain_start + k) % n];
+        int remaining = max - total;
+        int share = (remaining + (n - k) - 1) / (n - k);
+        total += ring_buffer_drain(&src->ring, fn, ctx, share, until_us);
+    }
+
+    drain_start = (drain_start + 1) % n;
+    return total;
+}
+
+/* Records queued across all sources */
+unsigned int capture_queued(void) {
+    unsigned int queued = 0;
+    for (int i = 0; i < capture_source_count; i++) {
+        queued += ring_buffer_count(&capture_sources[i]->ring);
+    }
+    return queued;
+}
+
+unsigned long capture_total_packets(void) {
+    unsigned long total = 0;
+    for (int i = 0; i < capture_source_count; i++) {
+        total += capture_sources[i]->packets;
+    }
+    return total;
+}
+
+/* Estimated bytes seen by a source, all directions and protocols */
+unsigned long capture_traffic_bytes(const capture_source_t *src) {
+    unsigned long total = 0;
+    for (int d = 0; d < TRAFFIC_DIRS; d++) {
+        for (int p = 0; p < TRAFFIC_PROTOS; p++) {
+            total += atomic_load_explicit(&src->traffic[d][p].bytes, memory_order_relaxed);
         }
     }
+    return total;
+}
 
-    return NULL;
+/* Fold each source's byte counter into its smoothed rate. Runs on the
+ * frame loop but only reads counters and the vDSO clock. */
+void capture_update_rates(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (int i = 0; i < capture_source_count; i++) {
+        capture_source_t *src = capture_sources[i];
+        double dt_ms = (now.tv_sec - src->rate_checked.tv_sec) * 1000.0
+                     + (now.tv_nsec - src->rate_checked.tv_nsec) / 1e6;
+        if (dt_ms < RATE_UPDATE_MS) continue;
+
+        unsigned long bytes = capture_traffic_bytes(src);
+        double instant = (bytes - src->rate_last_bytes) * 1000.0 / dt_ms;
+
+        /* alpha = dt / (tau + dt) tracks 1 - exp(-dt/tau) closely enough
+         * and copes with irregular frame timing */
+        double alpha = dt_ms / (RATE_EWMA_TAU_MS + dt_ms);
+        src->rate_ewma += alpha * (instant - src->rate_ewma);
+
+        src->rate_last_bytes = bytes;
+        src->rate_checked = now;
+        atomic_store(&src->bytes_per_sec, (unsigned long)(src->rate_ewma + 0.5));
+    }
+}
+
+/* Bytes seen by every worker capturing an interface */
+static unsigned long interface_traffic_bytes(const char *interface) {
+    unsigned long total = 0;
+    for (int i = 0; i < capture_source_count; i++) {
+        const capture_source_t *src = capture_sources[i];
+        if (src->backend != CAPTURE_BACKEND_FILE && strcmp(src->name, interface) == 0) {
+            total += capture_traffic_bytes(src);
+        }
+    }
+    return total;
+}
+
+/* Print per-direction and per-protocol totals, and compare the bytes the
+ * capture path saw with the interface's own counters (once per
+ * interface, on its first worker) */
+static void print_traffic_summary(const capture_source_t *src) {
+    static const char *const proto_names[TRAFFIC_PROTOS] = { "TCP", "UDP", "ICMP", "other" };
+    unsigned long dir_packets[TRAFFIC_DIRS] = { 0 }, dir_bytes[TRAFFIC_DIRS] = { 0 };
+    unsigned long proto_bytes[TRAFFIC_PROTOS] = { 0 };
+    unsigned long total = 0;
+
+    for (int d = 0; d < TRAFFIC_DIRS; d++) {
+        for (int p = 0; p < TRAFFIC_PROTOS; p++) {
+            unsigned long bytes = src->traffic[d][p].bytes;
+            dir_packets[d] += src->traffic[d][p].packets;
+            dir_bytes[d]   += bytes;
+            proto_bytes[p] += bytes;
+            total          += bytes;
+        }
+    }
+    if (total == 0) return;
+
+    printf("%s: in %lu pkts / %lu bytes, out %lu pkts / %lu bytes;",
+           src->label, dir_packets[TRAFFIC_IN], dir_bytes[TRAFFIC_IN],
+           dir_packets[TRAFFIC_OUT], dir_bytes[TRAFFIC_OUT]);
+    for (int p = 0; p < TRAFFIC_PROTOS; p++) {
+        printf(" %s %.1f%%", proto_names[p], 100.0 * proto_bytes[p] / total);
+    }
+    printf("\n");
+
+    unsigned long proc_bytes;
+    if (src->backend != CAPTURE_BACKEND_FILE && src->fanout_index == 0 &&
+        src->proc_start_bytes > 0 &&
+        read_interface_bytes(src->name, &proc_bytes) == 0 &&
+        proc_bytes > src->proc_start_bytes) {
+        unsigned long iface_bytes = proc_bytes - src->proc_start_bytes;
+        printf("%s: interface counters saw %lu bytes, capture path %.1f%% of that\n",
+               src->name, iface_bytes, 100.0 * interface_traffic_bytes(src->name) / iface_bytes);
+    }
+}
+
+/* Print capture totals, throughput and kernel drops per source, plus a
+ * per-interface total when fanout workers share an interface */
+void capture_print_summary(double elapsed_sec) {
+    printf("\nCaptured %lu packets\n", capture_total_packets());
+
+    for (int i = 0; i < capture_source_count; i++) {
+        capture_source_t *src = capture_sources[i];
+        unsigned long total = src->packets;
+        refresh_kernel_stats(src);
+
+        if (elapsed_sec > 0) {
+            printf("%s (%s): %lu packets, %.0f pkt/s over %.1f s, "
+                   "%lu dropped by kernel, %lu ring overflows\n",
+                   src->label, capture_backend_name(src->backend), total,
+                   total / elapsed_sec, elapsed_sec, (unsigned long)src->kernel_drops,
+                   (unsigned long)src->ring.overflows);
+        }
+        print_traffic_summary(src);
+        if (profiling && src->dissect_calls > 0) {
+            printf("%s: dissect %.1f %s/packet\n", src->label,
+                   (double)src->dissect_ticks / src->dissect_calls, PROFILE_UNIT);
+        }
+    }
+
+    if (fanout_workers <= 1 || elapsed_sec <= 0) return;
+
+    for (int i = 0; i < capture_source_count; i++) {
+        const capture_source_t *primary = capture_sources[i];
+        if (primary->fanout_index != 0 || primary->backend == CAPTURE_BACKEND_FILE) continue;
+
+        unsigned long packets = 0, dropped = 0, overflows = 0;
+        int workers = 0;
+        for (int j = i; j < capture_source_count; j++) {
+            const capture_source_t *src = capture_sources[j];
+            if (strcmp(src->name, primary->name) != 0) continue;
+            packets   += src->packets;
+            dropped   += src->kernel_drops;
+            overflows += src->ring.overflows;
+            workers++;
+        }
+        printf("%s total (%d workers, %s fanout): %.0f pkt/s, "
+               "%lu dropped by kernel, %lu ring overflows\n",
+               primary->name, workers, fanout_mode == CAPTURE_FANOUT_CPU ? "cpu" : "hash",
+               packets / elapsed_sec, dropped, overflows);
+    }
 }
 
 /* Auto-detect network interface */
@@ -347,66 +1016,98 @@ char *detect_interface(void) {
     return result;
 }
 
-/* Get local IP addresses for the given interface */
-void get_local_ips(const char *interface) {
+/* Find every interface that is up, running and not loopback */
+int detect_active_interfaces(char names[][SOURCE_NAME_LEN], int max) {
     struct ifaddrs *ifaddr, *ifa;
-    local_ip_count = 0;
+    int count = 0;
+
+    if (getifaddrs(&ifaddr) == -1) {
+        return 0;
+    }
+
+    for (ifa = ifaddr; ifa != NULL && count < max; ifa = ifa->ifa_next) {
+        if (!(ifa->ifa_flags & IFF_UP) || !(ifa->ifa_flags & IFF_RUNNING)) continue;
+        if (ifa->ifa_flags & IFF_LOOPBACK) continue;
+
+        /* getifaddrs lists an interface once per address family */
+        int seen = 0;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(names[i], ifa->ifa_name) == 0) {
+                seen = 1;
+                break;
+            }
+        }
+        if (!seen) {
+            snprintf(names[count++], SOURCE_NAME_LEN, "%s", ifa->ifa_name);
+        }
+    }
+
+    freeifaddrs(ifaddr);
+    return count;
+}
+
+/* Get local IPv4/IPv6 addresses for the given interface (all interfaces if NULL) */
+void get_local_ips(capture_source_t *src, const char *interface) {
+    struct ifaddrs *ifaddr, *ifa;
+    src->local_ip_count = 0;
 
     if (getifaddrs(&ifaddr) == -1) {
         return;
     }
 
-    for (ifa = ifaddr; ifa != NULL && local_ip_count < MAX_LOCAL_IPS; ifa = ifa->ifa_next) {
+    for (ifa = ifaddr; ifa != NULL && src->local_ip_count < MAX_LOCAL_IPS; ifa = ifa->ifa_next) {
         if (ifa->ifa_addr == NULL) continue;
-        if (ifa->ifa_addr->sa_family != AF_INET) continue;
+        int family = ifa->ifa_addr->sa_family;
+        if (family != AF_INET && family != AF_INET6) continue;
 
         if (interface == NULL || strcmp(ifa->ifa_name, interface) == 0) {
-            struct sockaddr_in *addr = (struct sockaddr_in *)ifa->ifa_addr;
-            local_ips[local_ip_count++] = addr->sin_addr;
+            local_addr_t *local = &src->local_ips[src->local_ip_count++];
+            memset(local, 0, sizeof(*local));
+            local->family = family;
+            if (family == AF_INET) {
+                memcpy(local->addr, &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr, 4);
+            } else {
+                memcpy(local->addr, &((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr, 16);
+            }
         }
     }
 
     freeifaddrs(ifaddr);
 }
 
-/* Check if an IP address is local */
-int is_local_ip(struct in_addr addr) {
-    for (int i = 0; i < local_ip_count; i++) {
-        if (local_ips[i].s_addr == addr.s_addr) {
+/* Check if an address is local to a source */
+int is_local_addr(const capture_source_t *src, int family, const uint8_t *addr) {
+    size_t len = family == AF_INET6 ? 16 : 4;
+    for (int i = 0; i < src->local_ip_count; i++) {
+        if (src->local_ips[i].family == family &&
+            memcmp(src->local_ips[i].addr, addr, len) == 0) {
             return 1;
         }
     }
     return 0;
 }
 
-/* Update network rate from /proc/net/dev */
-void update_network_rate(unsigned long frame_count) {
-    if (frame_count % 20 != 0) return;
-
-    time_t now = time(NULL);
-    if (now == last_time) return;
-
+/* Read an interface's rx + tx byte counters from /proc/net/dev */
+int read_interface_bytes(const char *interface, unsigned long *bytes) {
     FILE *f = fopen("/proc/net/dev", "r");
-    if (!f) return;
+    if (!f) return -1;
 
     char line[512];
-    unsigned long rx_bytes = 0, tx_bytes = 0;
+    int rc = -1;
 
     while (fgets(line, sizeof(line), f)) {
         char iface[32];
+        unsigned long rx_bytes, tx_bytes;
         if (sscanf(line, " %31[^:]: %lu %*u %*u %*u %*u %*u %*u %*u %lu",
-                   iface, &rx_bytes, &tx_bytes) == 3) {
-            if (net_interface && strcmp(iface, net_interface) == 0) {
-                break;
-            }
+                   iface, &rx_bytes, &tx_bytes) != 3) {
+            continue;
+        }
+        if (strcmp(iface, interface) == 0) {
+            *bytes = rx_bytes + tx_bytes;
+            rc = 0;
+            break;
         }
     }
     fclose(f);
-
-    unsigned long total = rx_bytes + tx_bytes;
-    if (last_bytes > 0) {
-        bytes_per_sec = (total - last_bytes) / (now - last_time);
-    }
-    last_bytes = total;
-    last_time = now;
+    return rc;
 }
@@ -2,24 +2,62 @@
 #define CAPTURE_H
 
 #include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 #include <pcap.h>
 #include <netinet/ip.h>
 #include <netinet/in.h>
 #include <stdatomic.h>
 
+#include "capture_tpacket.h"
+
 /* Configuration */
-#define MAX_PACKET_SIZE  1500
-#define RING_BUFFER_SIZE 2048
+#define RING_BUFFER_SIZE 2048  /* must be a power of two */
+#define CACHE_LINE_SIZE  64
 #define MIN_PACKET_DISPLAY 20
 #define PCAP_BATCH_SIZE  64
-#define CAPTURE_IDLE_US  1000
 #define PCAP_TIMEOUT_MS  100
-#define MAX_LOCAL_IPS    8
+#define MAX_LOCAL_IPS    16
+#define MAX_CAPTURE_SOURCES 64  /* interfaces times fanout workers */
+#define SOURCE_NAME_LEN  64
+#define SOURCE_LABEL_LEN (SOURCE_NAME_LEN + 8)
+
+/* Capture backends */
+#define CAPTURE_BACKEND_PCAP     0
+#define CAPTURE_BACKEND_TPACKET  1
+#define CAPTURE_BACKEND_FILE     2   /* offline pcap/pcapng file or stdin */
+
+/* PACKET_FANOUT modes for multi-worker capture */
+#define CAPTURE_FANOUT_HASH  0   /* by flow hash: a flow stays on one worker */
+#define CAPTURE_FANOUT_CPU   1   /* by the CPU that received the packet */
 
-/* Formatted packet info stored in ring buffer */
+/* Longest single sleep while pacing a replay, so shutdown stays prompt */
+#define REPLAY_MAX_SLEEP_MS  100
+
+/* Longest formatted stream text */
 #define MAX_INFO_LEN 256
 
+/* Payload bytes kept per record: all a hex stream can show ("xx " per byte) */
+#define HEX_PAYLOAD_MAX  ((MAX_INFO_LEN - 1) / 3)
+
+/* Snaplen: longest link header (SLL2) + two VLAN tags + IPv6 with room for
+ * extension headers + longest TCP header + the hex prefix. Nothing past
+ * this is ever displayed, so the kernel need not copy it. */
+#define CAPTURE_SNAPLEN  (20 + 8 + 40 + 64 + 60 + HEX_PAYLOAD_MAX)
+
+/* Throughput: the frame loop folds the capture counters into an
+ * exponentially weighted rate every RATE_UPDATE_MS, with time constant
+ * RATE_EWMA_TAU_MS */
+#define RATE_UPDATE_MS    250
+#define RATE_EWMA_TAU_MS  1000
+
+/* Adaptive sampling: keep 1 in N packets in the kernel filter while the
+ * ring stays saturated, relaxing again once the frame loop keeps up */
+#define SAMPLING_INTERVAL_MS 1000
+#define SAMPLING_RATE_MAX    1024
+#define SAMPLING_HIGH_WATER  (RING_BUFFER_SIZE * 3 / 4)
+#define SAMPLING_LOW_WATER   (RING_BUFFER_SIZE / 8)
+
 /* Column zone assignments */
 #define ZONE_ENCRYPTED_META  0
 #define ZONE_ENCRYPTED_HEX   1
@@ -37,44 +75,188 @@
 #define COLOR_INBOUND    9
 #define COLOR_OUTBOUND   10
 
+/* Network layer a record describes */
+#define PKT_KIND_IPV4  0
+#define PKT_KIND_IPV6  1
+#define PKT_KIND_ARP   2
+
+/* Raw header record stored in the ring buffer, filled by the dissector.
+ * Text and colors are only generated (format.c) for records that
+ * actually become streams. */
 typedef struct {
-    char text[MAX_INFO_LEN];
-    int colors[MAX_INFO_LEN];
-    int length;
-    int is_encrypted;
-    int is_inbound;
-    int column_zone;
-} packet_t;
+    uint8_t src[16];         /* IPv4 and ARP use the first 4 bytes */
+    uint8_t dst[16];
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t kind;            /* PKT_KIND_* */
+    uint8_t protocol;        /* IPPROTO_* of the transport layer */
+    uint8_t is_inbound;
+    uint8_t is_encrypted;
+    uint8_t payload_len;     /* bytes valid in payload[] */
+    uint32_t wire_len;       /* original packet length */
+    uint64_t captured_us;    /* kernel timestamp (wall clock), 0 on replay */
+    uint64_t queued_us;      /* when the capture thread queued it */
+    uint8_t payload[HEX_PAYLOAD_MAX];
+} packet_record_t;
 
+/* Single-producer/single-consumer ring. The capture thread owns head,
+ * the frame loop owns tail; each side keeps a cached copy of the other's
+ * index on its own cache line so the shared lines only bounce when the
+ * cached view runs out. */
 typedef struct {
-    packet_t packets[RING_BUFFER_SIZE];
-    int head;
-    int tail;
-    int count;
-    pthread_mutex_t lock;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head;  /* producer: next slot to fill */
+    unsigned int cached_tail;
+    atomic_ulong overflows;                      /* packets dropped on a full ring */
+
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;  /* consumer: next slot to read */
+    unsigned int cached_head;
+
+    _Alignas(CACHE_LINE_SIZE) packet_record_t records[RING_BUFFER_SIZE];
 } ring_buffer_t;
 
+/* Called for each drained record; the record is only valid during the call */
+typedef void (*ring_drain_fn)(const packet_record_t *rec, void *ctx);
+
+/* Traffic counter buckets */
+#define TRAFFIC_IN      0
+#define TRAFFIC_OUT     1
+#define TRAFFIC_DIRS    2
+
+#define TRAFFIC_TCP     0
+#define TRAFFIC_UDP     1
+#define TRAFFIC_ICMP    2   /* ICMP and ICMPv6 */
+#define TRAFFIC_OTHER   3   /* ARP and any other IP protocol */
+#define TRAFFIC_PROTOS  4
+
+/* Written only by the capture thread; others read with relaxed loads */
+typedef struct {
+    atomic_ulong packets;
+    atomic_ulong bytes;      /* on-the-wire length (pcap_pkthdr.len) */
+} traffic_counter_t;
+
+/* A local interface address, used to tell inbound from outbound */
+typedef struct {
+    int family;              /* AF_INET or AF_INET6 */
+    uint8_t addr[16];
+} local_addr_t;
+
+/* One capture source: a live interface or a replayed file, with its own
+ * capture thread and its own ring feeding the frame loop */
+typedef struct {
+    ring_buffer_t ring;                  /* first, to keep its alignment */
+
+    char name[SOURCE_NAME_LEN];          /* interface name or replay path */
+    char label[SOURCE_LABEL_LEN];        /* name, plus "/N" for fanout workers */
+    int fanout_index;                    /* worker number on the interface */
+    int backend;
+    int linktype;                        /* DLT_* handed to the dissector */
+    pcap_t *pcap;
+    tpacket_ring_t tpacket;
+    pthread_t thread;
+    int thread_started;
+    int epoll_fd;                        /* capture fd + stop event */
+
+    local_addr_t local_ips[MAX_LOCAL_IPS];
+    int local_ip_count;
+
+    /* Counters owned by the capture thread (see counter_add()) */
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong packets;  /* packets seen by this source */
+    atomic_ulong filtered;               /* packets the dissector rejected */
+    atomic_ulong kernel_drops;           /* backend drop counter, refreshed periodically */
+    struct timespec stats_checked;
+    atomic_uint sample_rate;             /* 1 in N kept by the kernel filter */
+
+    /* Per direction and protocol, scaled up by the sampling ratio so they
+     * estimate the real traffic (capture thread only writes) */
+    _Alignas(CACHE_LINE_SIZE) traffic_counter_t traffic[TRAFFIC_DIRS][TRAFFIC_PROTOS];
+
+    /* Queue stamp for the batch being dispatched (capture thread only) */
+    uint64_t batch_us;
+
+    /* Timestamp of the last record a simulated replay queued */
+    atomic_ulong replay_clock_us;
+
+    /* Dissector cost when profiling (capture thread only) */
+    unsigned long dissect_ticks;
+    unsigned long dissect_calls;
+
+    /* Adaptive sampling state (capture thread only) */
+    struct timespec sampling_checked;
+    unsigned long sampling_overflows;
+    int sampling_refused;                /* the kernel would not run the prefix */
+
+    /* Rate tracking state (frame loop writes) */
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong bytes_per_sec;  /* EWMA of the traffic byte counters */
+    struct timespec rate_checked;
+    unsigned long rate_last_bytes;
+    double rate_ewma;
+
+    /* /proc/net/dev byte counter when capture started, for the exit
+     * summary's cross-check (0 if unavailable) */
+    unsigned long proc_start_bytes;
+} capture_source_t;
+
 /* Globals (defined in capture.c) */
-extern ring_buffer_t ring_buffer;
-extern pcap_t *pcap_handle;
-extern atomic_ulong packets_captured;
-extern atomic_ulong bytes_per_sec;
-extern char *net_interface;
-extern struct in_addr local_ips[MAX_LOCAL_IPS];
-extern int local_ip_count;
+extern capture_source_t *capture_sources[MAX_CAPTURE_SOURCES];
+extern int capture_source_count;
+extern int capture_backend;
+extern int adaptive_sampling;
+extern double replay_speed;
+extern atomic_int capture_done;
+extern int capture_immediate;
+extern int fanout_workers;
+extern int fanout_mode;
 
 /* Ring buffer operations */
 void ring_buffer_init(ring_buffer_t *rb);
-int ring_buffer_push(ring_buffer_t *rb, packet_t *pkt);
-int ring_buffer_pop(ring_buffer_t *rb, packet_t *pkt);
+int ring_buffer_push(ring_buffer_t *rb, const packet_record_t *rec);
+int ring_buffer_drain(ring_buffer_t *rb, ring_drain_fn fn, void *ctx, int max,
+                      uint64_t until_us);
+unsigned int ring_buffer_count(ring_buffer_t *rb);
+
+/* Capture sources */
+capture_source_t *capture_add_source(const char *name);
+int capture_open_live(capture_source_t *src, char *errbuf);
+int capture_open_file(capture_source_t *src, char *errbuf);
+int capture_start(void);
+void capture_stop(void);
+void capture_close(void);
+
+/* Merge all source rings into the consumer, sharing max fairly and
+ * stopping at records queued after until_us */
+int capture_drain(ring_drain_fn fn, void *ctx, int max, uint64_t until_us);
+unsigned int capture_queued(void);
+unsigned long capture_total_packets(void);
+
+/* Simulation: the replay's first timestamp, and waiting until it has
+ * queued everything up to a frame's time */
+uint64_t capture_replay_start(void);
+void capture_sync_replay(uint64_t until_us);
+
+/* Sleeping the frame loop until packets arrive */
+int capture_event_fd(void);
+int capture_prepare_sleep(void);
+void capture_finish_sleep(void);
+
+/* Throughput */
+int traffic_protocol(const packet_record_t *rec);
+unsigned long capture_traffic_bytes(const capture_source_t *src);
+void capture_update_rates(void);
 
 /* Packet capture */
+void packet_handler(u_char *user, const struct pcap_pkthdr *header, const u_char *packet);
 void *capture_thread(void *arg);
+const char *capture_backend_name(int backend);
+void capture_print_summary(double elapsed_sec);
+
+/* BPF filter construction */
+int capture_compile_filter(int linktype, unsigned int rate, struct bpf_program *prog);
 
 /* Network helpers */
 char *detect_interface(void);
-void get_local_ips(const char *interface);
-int is_local_ip(struct in_addr addr);
-void update_network_rate(unsigned long frame_count);
+int detect_active_interfaces(char names[][SOURCE_NAME_LEN], int max);
+void get_local_ips(capture_source_t *src, const char *interface);
+int is_local_addr(const capture_source_t *src, int family, const uint8_t *addr);
+int read_interface_bytes(const char *interface, unsigned long *bytes);
 
 #endif /* CAPTURE_H */
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include "capture_tpacket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/if_arp.h>
+#include <linux/filter.h>
+
+/* Attach a classic BPF program (libpcap layout) to the socket */
+static int attach_filter(int fd, const struct bpf_program *prog, char *errbuf) {
+    struct sock_filter *insns = calloc(prog->bf_len, sizeof(*insns));
+    if (!insns) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "out of memory");
+        return -1;
+    }
+    for (unsigned int i = 0; i < prog->bf_len; i++) {
+        insns[i].code = prog->bf_insns[i].code;
+        insns[i].jt   = prog->bf_insns[i].jt;
+        insns[i].jf   = prog->bf_insns[i].jf;
+        insns[i].k    = prog->bf_insns[i].k;
+    }
+
+    struct sock_fprog fprog = { .len = prog->bf_len, .filter = insns };
+    int rc = setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+    if (rc != 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "SO_ATTACH_FILTER: %s", strerror(errno));
+    }
+
+    free(insns);
+    return rc == 0 ? 0 : -1;
+}
+
+static int interface_is_loopback(int fd, const char *interface) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface);
+    if (ioctl(fd, SIOCGIFFLAGS, &ifr) < 0) return 0;
+    return (ifr.ifr_flags & IFF_LOOPBACK) != 0;
+}
+
+/* SOCK_RAW delivers the device's own link header, if it has one */
+int tpacket_linktype(const char *interface) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", interface);
+    int rc = ioctl(fd, SIOCGIFHWADDR, &ifr);
+    close(fd);
+    if (rc < 0) return -1;
+
+    switch (ifr.ifr_hwaddr.sa_family) {
+        case ARPHRD_ETHER:
+        case ARPHRD_LOOPBACK:
+            return DLT_EN10MB;
+        case ARPHRD_NONE:      /* tun */
+        case ARPHRD_PPP:
+        case ARPHRD_TUNNEL:
+        case ARPHRD_TUNNEL6:
+        case ARPHRD_IPGRE:
+            return DLT_RAW;
+        default:
+            return -1;
+    }
+}
+
+/* Open and map a TPACKET_V3 ring */
+int tpacket_open(tpacket_ring_t *ring, const char *interface,
+                 const struct bpf_program *prog, char *errbuf) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    unsigned int ifindex = if_nametoindex(interface);
+    if (ifindex == 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: no such interface", interface);
+        return -1;
+    }
+
+    /* Protocol 0 receives nothing until the bind below names both the
+     * interface and ETH_P_ALL, so no other interface's frames get in */
+    int fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "socket(AF_PACKET): %s", strerror(errno));
+        return -1;
+    }
+    ring->fd = fd;
+
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_VERSION: %s", strerror(errno));
+        goto fail;
+    }
+
+    /* Filter before the bind starts delivery, so no unfiltered packets
+     * sneak in */
+    if (prog && attach_filter(fd, prog, errbuf) != 0) {
+        goto fail;
+    }
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family   = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex  = (int)ifindex;
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "bind %s: %s", interface, strerror(errno));
+        goto fail;
+    }
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = TPACKET_BLOCK_SIZE;
+    req.tp_block_nr   = TPACKET_BLOCK_COUNT;
+    req.tp_frame_size = TPACKET_FRAME_SIZE;
+    req.tp_frame_nr   = (TPACKET_BLOCK_SIZE / TPACKET_FRAME_SIZE) * TPACKET_BLOCK_COUNT;
+    req.tp_retire_blk_tov = TPACKET_RETIRE_MS;
+    req.tp_feature_req_word = 0;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "PACKET_RX_RING: %s", strerror(errno));
+        goto fail;
+    }
+
+    ring->block_size  = req.tp_block_size;
+    ring->block_count = req.tp_block_nr;
+    ring->map_size    = (size_t)req.tp_block_size * req.tp_block_nr;
+    ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (ring->map == MAP_FAILED) {
+        /* MAP_LOCKED needs RLIMIT_MEMLOCK headroom; retry without it */
+        ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    }
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "mmap ring: %s", strerror(errno));
+        goto fail;
+    }
+
+    ring->is_loopback = interface_is_loopback(fd, interface);
+    return 0;
+
+fail:
+    tpacket_close(ring);
+    return -1;
+}
+
+/* Swap the filter; the kernel replaces the old program atomically */
+int tpacket_set_filter(tpacket_ring_t *ring, const struct bpf_program *prog, char *errbuf) {
+    return attach_filter(ring->fd, prog, errbuf);
+}
+
+/* Deliver all packets from ready blocks without copying them */
+int tpacket_dispatch(tpacket_ring_t *ring, pcap_handler callback, u_char *user) {
+    int delivered = 0;
+
+    for (unsigned int n = 0; n < ring->block_count; n++) {
+        struct tpacket_block_desc *bd = (struct tpacket_block_desc *)
+            (ring->map + (size_t)ring->current * ring->block_size);
+
+        if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            break;
+
+        uint32_t num_pkts = bd->hdr.bh1.num_pkts;
+        struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)
+            ((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+
+        for (uint32_t i = 0; i < num_pkts; i++) {
+            const struct sockaddr_ll *sll = (const struct sockaddr_ll *)
+                ((uint8_t *)ppd + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+            /* Loopback sees every packet twice; keep the inbound copy like libpcap */
+            if (!(ring->is_loopback && sll->sll_pkttype == PACKET_OUTGOING)) {
+                struct pcap_pkthdr hdr;
+                hdr.ts.tv_sec  = ppd->tp_sec;
+                hdr.ts.tv_usec = ppd->tp_nsec / 1000;
+                hdr.caplen     = ppd->tp_snaplen;
+                hdr.len        = ppd->tp_len;
+                callback(user, &hdr, (const u_char *)ppd + ppd->tp_mac);
+                delivered++;
+            }
+
+            ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+        }
+
+        /* Hand the block back to the kernel */
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring->current = (ring->current + 1) % ring->block_count;
+    }
+
+    return delivered;
+}
+
+/* Read kernel counters (the kernel resets them on every read) */
+int tpacket_get_stats(tpacket_ring_t *ring, tpacket_stats_t *stats) {
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if (getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0) {
+        return -1;
+    }
+    stats->packets      = st.tp_packets;
+    stats->drops        = st.tp_drops;
+    stats->freeze_count = st.tp_freeze_q_cnt;
+    return 0;
+}
+
+/* Release the ring */
+void tpacket_close(tpacket_ring_t *ring) {
+    if (ring->map) {
+        munmap(ring->map, ring->map_size);
+        ring->map = NULL;
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+        ring->fd = -1;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CAPTURE_TPACKET_H
+#define CAPTURE_TPACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pcap.h>
+
+/* Configuration */
+#define TPACKET_BLOCK_SIZE    (1 << 18)  /* 256 KiB per ring block */
+#define TPACKET_BLOCK_COUNT   64
+#define TPACKET_FRAME_SIZE    2048
+#define TPACKET_RETIRE_MS     100        /* same latency bound as PCAP_TIMEOUT_MS */
+
+/* AF_PACKET TPACKET_V3 receive ring mapped into our address space */
+typedef struct {
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    unsigned int block_size;
+    unsigned int block_count;
+    unsigned int current;      /* next block to inspect */
+    int is_loopback;           /* skip PACKET_OUTGOING duplicates on lo */
+} tpacket_ring_t;
+
+/* Kernel counters read back with PACKET_STATISTICS */
+typedef struct {
+    unsigned long packets;
+    unsigned long drops;
+    unsigned long freeze_count;
+} tpacket_stats_t;
+
+/* pcap link type the ring will deliver for an interface, or -1 if the
+ * interface's hardware type is not one the dissector understands */
+int tpacket_linktype(const char *interface);
+
+/* Open a TPACKET_V3 socket on an interface, attach the BPF program
+ * (may be NULL) and map the ring. The program's accept value sets the
+ * snaplen. Returns 0 on success, -1 on failure with a message in errbuf. */
+int tpacket_open(tpacket_ring_t *ring, const char *interface,
+                 const struct bpf_program *prog, char *errbuf);
+
+/* Replace the socket filter on an open ring */
+int tpacket_set_filter(tpacket_ring_t *ring, const struct bpf_program *prog, char *errbuf);
+
+/* Walk every block the kernel has handed to userspace, invoking the
+ * callback for each packet in place, then return the blocks.
+ * Returns the number of packets delivered. */
+int tpacket_dispatch(tpacket_ring_t *ring, pcap_handler callback, u_char *user);
+
+/* Read (and reset) the kernel packet/drop counters */
+int tpacket_get_stats(tpacket_ring_t *ring, tpacket_stats_t *stats);
+
+/* Unmap the ring and close the socket */
+void tpacket_close(tpacket_ring_t *ring);
+
+#endif /* CAPTURE_TPACKET_H */
@@ -0,0 +1,140 @@
+#include "columns.h"
+#include "prng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define WORD_BITS 64
+
+/* Globals */
+int column_zones = 0;   /* set by --zones */
+
+/* Private state: one bit per column. A column is spaced when it and its
+ * COLUMN_GAP neighbours each side are unoccupied, i.e. a stream may start
+ * there. Both maps are kept in step on every claim and release, so a
+ * search only reads spaced. */
+static uint64_t *occupied = NULL;
+static uint64_t *spaced = NULL;
+static int column_count = 0;
+static int word_count = 0;
+static prng_t column_rng;
+
+static inline int bit_test(const uint64_t *map, int col) {
+    return (int)((map[col / WORD_BITS] >> (col % WORD_BITS)) & 1);
+}
+
+static inline void bit_set(uint64_t *map, int col) {
+    map[col / WORD_BITS] |= 1ULL << (col % WORD_BITS);
+}
+
+static inline void bit_clear(uint64_t *map, int col) {
+    map[col / WORD_BITS] &= ~(1ULL << (col % WORD_BITS));
+}
+
+/* Recompute one column's spaced bit from the occupancy map */
+static void update_spaced(int col) {
+    if (col < 0 || col >= column_count) return;
+
+    int lo = col - COLUMN_GAP < 0 ? 0 : col - COLUMN_GAP;
+    int hi = col + COLUMN_GAP >= column_count ? column_count - 1 : col + COLUMN_GAP;
+    for (int c = lo; c <= hi; c++) {
+        if (bit_test(occupied, c)) {
+            bit_clear(spaced, col);
+            return;
+        }
+    }
+    bit_set(spaced, col);
+}
+
+/* Columns [lo, hi) a zone may use */
+static void zone_range(int zone, int *lo, int *hi) {
+    if (!column_zones) {
+        *lo = 0;
+        *hi = column_count;
+        return;
+    }
+    *lo = column_count * zone / COLUMN_ZONES;
+    *hi = column_count * (zone + 1) / COLUMN_ZONES;
+}
+
+/* Word i of a map with bits outside [lo, hi) cleared */
+static uint64_t range_word(const uint64_t *map, int i, int lo, int hi) {
+    uint64_t w = map[i];
+    int base = i * WORD_BITS;
+    if (lo > base) w &= ~0ULL << (lo - base);
+    if (hi < base + WORD_BITS) w &= (1ULL << (hi - base)) - 1;
+    return w;
+}
+
+void columns_seed(uint64_t seed) {
+    prng_seed(&column_rng, seed);
+}
+
+void columns_init(int width) {
+    column_count = width > 0 ? width : 0;
+    word_count = (column_count + WORD_BITS - 1) / WORD_BITS;
+
+    free(occupied);
+    free(spaced);
+    occupied = calloc(word_count ? word_count : 1, sizeof(uint64_t));
+    spaced = calloc(word_count ? word_count : 1, sizeof(uint64_t));
+    if (!occupied || !spaced) {
+        fprintf(stderr, "Failed to allocate column maps\n");
+        exit(1);
+    }
+
+    memset(spaced, 0xff, word_count * sizeof(uint64_t));
+    if (column_count % WORD_BITS) {
+        spaced[word_count - 1] = (1ULL << (column_count % WORD_BITS)) - 1;
+    }
+}
+
+/* Two passes over the zone's words: count the candidates, then take
+ * the randomly chosen one. O(words) however full the screen is. */
+int column_claim(int zone) {
+    int lo, hi;
+    zone_range(zone, &lo, &hi);
+    if (lo >= hi) return -1;
+
+    int first = lo / WORD_BITS;
+    int last = (hi - 1) / WORD_BITS;
+
+    int total = 0;
+    for (int i = first; i <= last; i++) {
+        total += __builtin_popcountll(range_word(spaced, i, lo, hi));
+    }
+    if (total == 0) return -1;
+
+    int pick = (int)prng_below(&column_rng, (uint32_t)total);
+    for (int i = first; i <= last; i++) {
+        uint64_t w = range_word(spaced, i, lo, hi);
+        int n = __builtin_popcountll(w);
+        if (pick >= n) {
+            pick -= n;
+            continue;
+        }
+
+        while (pick-- > 0) w &= w - 1;   /* drop the lower candidates */
+        int col = i * WORD_BITS + __builtin_ctzll(w);
+
+        bit_set(occupied, col);
+        int from = col - COLUMN_GAP < 0 ? 0 : col - COLUMN_GAP;
+        int to = col + COLUMN_GAP >= column_count ? column_count - 1 : col + COLUMN_GAP;
+        for (int c = from; c <= to; c++) {
+            bit_clear(spaced, c);
+        }
+        return col;
+    }
+    return -1;
+}
+
+void column_release(int col) {
+    if (col < 0 || col >= column_count) return;
+
+    bit_clear(occupied, col);
+    for (int c = col - COLUMN_GAP; c <= col + COLUMN_GAP; c++) {
+        update_spaced(c);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stdint.h>
+
+#include "capture.h"
+
+/* Configuration */
+#define COLUMN_GAP    1   /* empty columns kept either side of a stream */
+#define COLUMN_ZONES  3   /* ZONE_* bands when --zones splits the screen */
+
+/* Globals (defined in columns.c) */
+extern int column_zones;
+
+/* Seed the generator behind column choice */
+void columns_seed(uint64_t seed);
+
+/* Size the occupancy maps for a screen width, all columns free */
+void columns_init(int width);
+
+/* Claim a random free column that keeps COLUMN_GAP free neighbours,
+ * within the zone's band if --zones is set. Returns -1 if none. */
+int column_claim(int zone);
+
+/* Return a claimed column */
+void column_release(int col);
+
+#endif /* COLUMNS_H */
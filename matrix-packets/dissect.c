@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+#include "dissect.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/ethernet.h>
+
+/* Ethertypes not every libc names */
+#ifndef ETHERTYPE_IPV6
+#define ETHERTYPE_IPV6   0x86dd
+#endif
+#define ETHERTYPE_QINQ   0x88a8
+#define ETHERTYPE_QINQ1  0x9100
+
+/* Big-endian loads that are safe on unaligned capture buffers */
+static inline uint16_t rd16(const u_char *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t rd32(const u_char *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/* Dissector output shared by the layers below */
+typedef struct {
+    packet_record_t *rec;
+    const u_char *payload;
+    uint32_t payload_len;
+} dissect_ctx_t;
+
+typedef int (*layer_fn)(const u_char *p, uint32_t len, dissect_ctx_t *ctx);
+
+/* ── Transport layer ─────────────────────────────────────────── */
+
+static int dissect_transport(int protocol, const u_char *p, uint32_t len, dissect_ctx_t *ctx) {
+    uint32_t header_len;
+
+    if (protocol == IPPROTO_TCP) {
+        if (len < 20) return 0;
+        header_len = (p[12] >> 4) * 4;
+        if (header_len < 20) header_len = 20;
+    } else if (protocol == IPPROTO_UDP) {
+        if (len < 8) return 0;
+        header_len = 8;
+    } else {
+        return 0;
+    }
+
+    ctx->rec->src_port = rd16(p);
+    ctx->rec->dst_port = rd16(p + 2);
+
+    if (len > header_len) {
+        ctx->payload = p + header_len;
+        ctx->payload_len = len - header_len;
+    }
+    return 0;
+}
+
+/* ── Network layer ───────────────────────────────────────────── */
+
+static int dissect_ipv4(const u_char *p, uint32_t len, dissect_ctx_t *ctx) {
+    if (len < 20 || (p[0] >> 4) != 4) return -1;
+
+    uint32_t header_len = (p[0] & 0x0f) * 4;
+    if (header_len < 20 || len < header_len) return -1;
+
+    packet_record_t *rec = ctx->rec;
+    rec->kind = PKT_KIND_IPV4;
+    rec->protocol = p[9];
+    memcpy(rec->src, p + 12, 4);
+    memcpy(rec->dst, p + 16, 4);
+
+    /* Only the first fragment carries the transport header */
+    if ((rd16(p + 6) & 0x1fff) != 0) return 0;
+
+    return dissect_transport(rec->protocol, p + header_len, len - header_len, ctx);
+}
+
+static int dissect_ipv6(const u_char *p, uint32_t len, dissect_ctx_t *ctx) {
+    if (len < 40 || (p[0] >> 4) != 6) return -1;
+
+    packet_record_t *rec = ctx->rec;
+    rec->kind = PKT_KIND_IPV6;
+    memcpy(rec->src, p + 8, 16);
+    memcpy(rec->dst, p + 24, 16);
+
+    int next = p[6];
+    uint32_t off = 40;
+
+    /* Walk extension headers to the upper-layer protocol */
+    for (int i = 0; i < MAX_IPV6_EXT_HDRS; i++) {
+        uint32_t ext_len;
+        switch (next) {
+            case IPPROTO_HOPOPTS:
+            case IPPROTO_ROUTING:
+            case IPPROTO_DSTOPTS:
+                if (len < off + 2) goto done;
+                ext_len = (p[off + 1] + 1) * 8;
+                break;
+            case IPPROTO_AH:
+                if (len < off + 2) goto done;
+                ext_len = (p[off + 1] + 2) * 4;
+                break;
+            case IPPROTO_FRAGMENT:
+                if (len < off + 8) goto done;
+                /* Later fragments have no transport header */
+                if ((rd16(p + off + 2) & 0xfff8) != 0) {
+                    rec->protocol = p[off];
+                    return 0;
+                }
+                ext_len = 8;
+                break;
+            default:
+                goto done;
+        }
+        next = p[off];
+        off += ext_len;
+        if (off > len) {
+            rec->protocol = next;
+            return 0;
+        }
+    }
+
+done:
+    rec->protocol = next;
+    return dissect_transport(next, p + off, len - off, ctx);
+}
+
+static int dissect_arp(const u_char *p, uint32_t len, dissect_ctx_t *ctx) {
+    if (len < 8) return -1;
+
+    uint32_t hlen = p[4];
+    uint32_t plen = p[5];
+    if (rd16(p + 2) != ETHERTYPE_IP || plen != 4) return -1;
+    if (len < 8 + 2 * hlen + 2 * plen) return -1;
+
+    packet_record_t *rec = ctx->rec;
+    rec->kind = PKT_KIND_ARP;
+    rec->protocol = 0;
+    memcpy(rec->src, p + 8 + hlen, 4);              /* sender protocol address */
+    memcpy(rec->dst, p + 8 + 2 * hlen + plen, 4);   /* target protocol address */
+    return 0;
+}
+
+static const struct {
+    uint16_t ethertype;
+    layer_fn fn;
+} network_layers[] = {
+    { ETHERTYPE_IP,   dissect_ipv4 },
+    { ETHERTYPE_IPV6, dissect_ipv6 },
+    { ETHERTYPE_ARP,  dissect_arp  },
+};
+
+#define NETWORK_LAYER_COUNT (sizeof(network_layers) / sizeof(network_layers[0]))
+
+/* Dispatch on an ethertype, peeling any VLAN tags first */
+static int dissect_ethertype(uint16_t ethertype, const u_char *p, uint32_t len, dissect_ctx_t *ctx) {
+    for (int depth = 0; depth < MAX_VLAN_DEPTH; depth++) {
+        if (ethertype != ETHERTYPE_VLAN && ethertype != ETHERTYPE_QINQ &&
+            ethertype != ETHERTYPE_QINQ1)
+            break;
+        if (len < 4) return -1;
+        ethertype = rd16(p + 2);
+        p += 4;
+        len -= 4;
+    }
+
+    for (size_t i = 0; i < NETWORK_LAYER_COUNT; i++) {
+        if (network_layers[i].ethertype == ethertype) {
+            return network_layers[i].fn(p, len, ctx);
+        }
+    }
+    return -1;
+}
+
+/* ── Link layer ──────────────────────────────────────────────── */
+
+/* How a link header says what follows it */
+#define LINK_ETHERTYPE  0   /* 16-bit ethertype at type_offset */
+#define LINK_VERSION    1   /* bare IP: the version nibble decides */
+#define LINK_AF_HOST    2   /* 32-bit BSD address family, host order (DLT_NULL) */
+#define LINK_AF_NET     3   /* 32-bit BSD address family, network order (DLT_LOOP) */
+
+static const struct {
+    int linktype;
+    uint8_t header_len;
+    uint8_t type_offset;
+    uint8_t encoding;
+} link_layers[] = {
+    { DLT_EN10MB,     14, 12, LINK_ETHERTYPE },
+    { DLT_LINUX_SLL,  16, 14, LINK_ETHERTYPE },
+#ifdef DLT_LINUX_SLL2
+    { DLT_LINUX_SLL2, 20,  0, LINK_ETHERTYPE },
+#endif
+    { DLT_RAW,         0,  0, LINK_VERSION   },
+#ifdef DLT_IPV4
+    { DLT_IPV4,        0,  0, LINK_VERSION   },
+    { DLT_IPV6,        0,  0, LINK_VERSION   },
+#endif
+    { DLT_NULL,        4,  0, LINK_AF_HOST   },
+    { DLT_LOOP,        4,  0, LINK_AF_NET    },
+};
+
+#define LINK_LAYER_COUNT (sizeof(link_layers) / sizeof(link_layers[0]))
+
+/* BSD AF_INET6 differs between the systems that wrote the capture */
+static int af_to_ethertype(uint32_t af) {
+    switch (af) {
+        case 2:
+            return ETHERTYPE_IP;
+        case 10:    /* Linux */
+        case 24:    /* OpenBSD, NetBSD */
+        case 28:    /* FreeBSD */
+        case 30:    /* macOS */
+            return ETHERTYPE_IPV6;
+        default:
+            return -1;
+    }
+}
+
+static int find_link_layer(int linktype) {
+    for (size_t i = 0; i < LINK_LAYER_COUNT; i++) {
+        if (link_layers[i].linktype == linktype) return (int)i;
+    }
+    return -1;
+}
+
+int dissect_supports(int linktype) {
+    return find_link_layer(linktype) >= 0;
+}
+
+int dissect_packet(int linktype, const u_char *data, uint32_t caplen,
+                   packet_record_t *rec, const u_char **payload,
+                   uint32_t *payload_len) {
+    int li = find_link_layer(linktype);
+    if (li < 0) return -1;
+
+    uint32_t header_len = link_layers[li].header_len;
+    if (caplen < header_len) return -1;
+
+    memset(rec->src, 0, sizeof(rec->src));
+    memset(rec->dst, 0, sizeof(rec->dst));
+    rec->src_port = 0;
+    rec->dst_port = 0;
+
+    dissect_ctx_t ctx = { .rec = rec, .payload = NULL, .payload_len = 0 };
+    const u_char *p = data + header_len;
+    uint32_t len = caplen - header_len;
+    int ethertype;
+    int rc;
+
+    switch (link_layers[li].encoding) {
+        case LINK_ETHERTYPE:
+            ethertype = rd16(data + link_layers[li].type_offset);
+            break;
+        case LINK_VERSION:
+            if (len < 1) return -1;
+            ethertype = (p[0] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
+            break;
+        case LINK_AF_HOST: {
+            uint32_t af;
+            memcpy(&af, data, sizeof(af));
+            ethertype = af_to_ethertype(af);
+            break;
+        }
+        default:
+            ethertype = af_to_ethertype(rd32(data));
+            break;
+    }
+    if (ethertype < 0) return -1;
+
+    rc = dissect_ethertype((uint16_t)ethertype, p, len, &ctx);
+    if (rc != 0) return rc;
+
+    *payload = ctx.payload;
+    *payload_len = ctx.payload_len;
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef DISSECT_H
+#define DISSECT_H
+
+#include "capture.h"
+
+/* Configuration */
+#define MAX_VLAN_DEPTH     4   /* stacked 802.1Q / 802.1ad tags followed */
+#define MAX_IPV6_EXT_HDRS  8   /* IPv6 extension headers walked */
+
+/* Returns 1 if dissect_packet() understands a pcap link type */
+int dissect_supports(int linktype);
+
+/* Parse a captured frame in place, link layer first, into rec.
+ * Fills addresses, ports, kind and protocol; on return *payload points
+ * at the transport payload inside data (NULL if there is none).
+ * Every read is bounds-checked against caplen.
+ * Returns 0 if a record was produced, -1 if the frame is not shown. */
+int dissect_packet(int linktype, const u_char *data, uint32_t caplen,
+                   packet_record_t *rec, const u_char **payload,
+                   uint32_t *payload_len);
+
+#endif /* DISSECT_H */
@@ -0,0 +1,202 @@
+#include "flows.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+_Static_assert((FLOW_TABLE_SIZE & (FLOW_TABLE_SIZE - 1)) == 0,
+               "FLOW_TABLE_SIZE must be a power of two");
+
+#define FLOW_MASK (FLOW_TABLE_SIZE - 1)
+
+/* Open-addressing table with linear probing (frame loop only) */
+static flow_t flow_table[FLOW_TABLE_SIZE];
+static int flow_count = 0;
+static double flow_last_sweep = 0;
+
+/* Lifetime counters for the exit summary */
+static unsigned long flows_created = 0;
+static unsigned long flows_evicted = 0;
+
+/* Build the direction-independent key for a record */
+static void flow_make_key(const packet_record_t *rec, flow_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->kind = rec->kind;
+    key->protocol = rec->protocol;
+
+    int cmp = memcmp(rec->src, rec->dst, sizeof(rec->src));
+    if (cmp < 0 || (cmp == 0 && rec->src_port <= rec->dst_port)) {
+        memcpy(key->addr_a, rec->src, 16);
+        memcpy(key->addr_b, rec->dst, 16);
+        key->port_a = rec->src_port;
+        key->port_b = rec->dst_port;
+    } else {
+        memcpy(key->addr_a, rec->dst, 16);
+        memcpy(key->addr_b, rec->src, 16);
+        key->port_a = rec->dst_port;
+        key->port_b = rec->src_port;
+    }
+}
+
+/* FNV-1a over the key bytes */
+static uint32_t flow_hash(const flow_key_t *key) {
+    const uint8_t *p = (const uint8_t *)key;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Remove slot i, shifting later members of its probe run back so that
+ * lookups never hit a premature empty slot */
+static void flow_delete(unsigned int i) {
+    unsigned int j = i;
+    for (;;) {
+        j = (j + 1) & FLOW_MASK;
+        if (!flow_table[j].used) break;
+
+        unsigned int home = flow_table[j].hash & FLOW_MASK;
+        /* Move j into the hole unless its home lies cyclically in (i, j] */
+        int stays = (i <= j) ? (i < home && home <= j)
+                             : (i < home || home <= j);
+        if (!stays) {
+            flow_table[i] = flow_table[j];
+            i = j;
+        }
+    }
+    flow_table[i].used = 0;
+    flow_count--;
+}
+
+/* Table full: evict the least recently seen of the next few flows from
+ * this key's home slot on (a sampled approximation of LRU) */
+static void flow_evict(uint32_t hash) {
+    unsigned int victim = 0;
+    int sampled = 0;
+    for (unsigned int i = hash & FLOW_MASK; sampled < FLOW_EVICT_SAMPLES;
+         i = (i + 1) & FLOW_MASK) {
+        if (!flow_table[i].used) continue;
+        if (sampled == 0 || flow_table[i].last_seen < flow_table[victim].last_seen) {
+            victim = i;
+        }
+        sampled++;
+    }
+    flow_delete(victim);
+    flows_evicted++;
+}
+
+/* Slot holding key, or the empty slot ending its probe run */
+static unsigned int flow_slot(const flow_key_t *key, uint32_t hash) {
+    unsigned int i = hash & FLOW_MASK;
+    while (flow_table[i].used) {
+        const flow_t *f = &flow_table[i];
+        if (f->hash == hash && memcmp(&f->key, key, sizeof(*key)) == 0) break;
+        i = (i + 1) & FLOW_MASK;
+    }
+    return i;
+}
+
+flow_t *flow_find(const packet_record_t *rec) {
+    flow_key_t key;
+    flow_make_key(rec, &key);
+    flow_t *f = &flow_table[flow_slot(&key, flow_hash(&key))];
+    return f->used ? f : NULL;
+}
+
+flow_t *flow_track(const packet_record_t *rec, double now, int *created) {
+    flow_key_t key;
+    flow_make_key(rec, &key);
+    uint32_t hash = flow_hash(&key);
+
+    *created = 0;
+    unsigned int i = flow_slot(&key, hash);
+    if (flow_table[i].used) {
+        flow_t *f = &flow_table[i];
+        f->packets++;
+        f->bytes += rec->wire_len;
+        f->last_seen = now;
+        return f;
+    }
+
+    if (flow_count >= FLOW_MAX_LOAD) {
+        flow_evict(hash);
+        /* Eviction may have shifted the run; find the first hole again */
+        i = hash & FLOW_MASK;
+        while (flow_table[i].used) i = (i + 1) & FLOW_MASK;
+    }
+
+    flow_t *f = &flow_table[i];
+    f->key = key;
+    f->hash = hash;
+    f->used = 1;
+    f->packets = 1;
+    f->bytes = rec->wire_len;
+    f->first_seen = now;
+    f->last_seen = now;
+    f->meta_stream = -1;
+    f->hex_stream = -1;
+    f->meta_offered = 0;
+    f->hex_offered = 0;
+    flow_count++;
+    flows_created++;
+
+    *created = 1;
+    return f;
+}
+
+void flow_expire(double now) {
+    if (now - flow_last_sweep < FLOW_SWEEP_INTERVAL_SEC) return;
+    flow_last_sweep = now;
+
+    for (unsigned int i = 0; i < FLOW_TABLE_SIZE; i++) {
+        /* A deletion can shift another flow into slot i; look again */
+        while (flow_table[i].used &&
+               now - flow_table[i].last_seen > FLOW_IDLE_TIMEOUT_SEC) {
+            flow_delete(i);
+        }
+    }
+}
+
+static void format_endpoint(const flow_key_t *key, const uint8_t *addr, uint16_t port,
+                            char *buf, size_t size) {
+    char ip[INET6_ADDRSTRLEN];
+    inet_ntop(key->kind == PKT_KIND_IPV6 ? AF_INET6 : AF_INET, addr, ip, sizeof(ip));
+    if (port > 0) {
+        snprintf(buf, size, key->kind == PKT_KIND_IPV6 ? "[%s]:%u" : "%s:%u", ip, port);
+    } else {
+        snprintf(buf, size, "%s", ip);
+    }
+}
+
+void flow_print_summary(void) {
+    printf("Flows: %lu seen, %d still tracked, %lu evicted from a full table\n",
+           flows_created, flow_count, flows_evicted);
+
+    /* Pick the busiest by bytes with repeated passes; the list is tiny */
+    const flow_t *top[FLOW_TOP_COUNT];
+    int top_count = 0;
+    for (int n = 0; n < FLOW_TOP_COUNT; n++) {
+        const flow_t *best = NULL;
+        for (unsigned int i = 0; i < FLOW_TABLE_SIZE; i++) {
+            const flow_t *f = &flow_table[i];
+            if (!f->used) continue;
+            if (best && f->bytes <= best->bytes) continue;
+            if (n > 0 && (f->bytes > top[n - 1]->bytes ||
+                          (f->bytes == top[n - 1]->bytes && f <= top[n - 1]))) continue;
+            best = f;
+        }
+        if (!best) break;
+        top[top_count++] = best;
+    }
+
+    for (int n = 0; n < top_count; n++) {
+        const flow_t *f = top[n];
+        char a[INET6_ADDRSTRLEN + 8], b[INET6_ADDRSTRLEN + 8];
+        format_endpoint(&f->key, f->key.addr_a, f->key.port_a, a, sizeof(a));
+        format_endpoint(&f->key, f->key.addr_b, f->key.port_b, b, sizeof(b));
+        printf("  %s <> %s: %lu pkts, %lu bytes over %.1f s\n", a, b,
+               f->packets, f->bytes, f->last_seen - f->first_seen);
+    }
+}
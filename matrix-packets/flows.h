@@ -0,0 +1,61 @@
+#ifndef FLOWS_H
+#define FLOWS_H
+
+#include "capture.h"
+
+/* Configuration */
+#define FLOW_TABLE_SIZE        4096   /* slots, must be a power of two */
+#define FLOW_MAX_LOAD          (FLOW_TABLE_SIZE * 3 / 4)
+#define FLOW_IDLE_TIMEOUT_SEC  30.0   /* flows quiet this long are forgotten */
+#define FLOW_SWEEP_INTERVAL_SEC 1.0
+#define FLOW_EVICT_SAMPLES     8      /* probe-run slots compared when full */
+#define FLOW_TOP_COUNT         5      /* busiest flows listed on exit */
+
+/* 5-tuple, ordered so both directions of a connection share one key */
+typedef struct {
+    uint8_t addr_a[16];
+    uint8_t addr_b[16];
+    uint16_t port_a;
+    uint16_t port_b;
+    uint8_t kind;            /* PKT_KIND_* */
+    uint8_t protocol;
+} flow_key_t;
+
+typedef struct {
+    flow_key_t key;
+    uint32_t hash;
+    uint8_t used;
+
+    unsigned long packets;
+    unsigned long bytes;
+    double first_seen;       /* CLOCK_MONOTONIC seconds */
+    double last_seen;
+
+    /* Streams currently showing this flow; valid while the stream's
+     * generation still matches */
+    int meta_stream;
+    unsigned int meta_generation;
+    int hex_stream;
+    unsigned int hex_generation;
+
+    /* admit_frame in which each stream was last offered, so a burst
+     * from one flow is offered once per frame */
+    unsigned int meta_offered;
+    unsigned int hex_offered;
+} flow_t;
+
+/* Find or create the flow for a record and count it. Sets *created when
+ * the flow is new. Never fails: a full table evicts its stalest entry. */
+flow_t *flow_track(const packet_record_t *rec, double now, int *created);
+
+/* The tracked flow of a record, or NULL; counts nothing. Pointers stay
+ * valid only until the next flow_track() or flow_expire(). */
+flow_t *flow_find(const packet_record_t *rec);
+
+/* Forget flows idle longer than FLOW_IDLE_TIMEOUT_SEC (rate-limited) */
+void flow_expire(double now);
+
+/* Print flow counts and the busiest flows still tracked */
+void flow_print_summary(void);
+
+#endif /* FLOWS_H */
@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+#include "format.h"
+#include "resolver.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FORMAT_HAVE_X86 1
+#endif
+
+static const char hexchars[] = "0123456789abcdef";
+
+_Static_assert(MAX_INFO_LEN - 1 <= UINT8_MAX, "color span length overflows");
+
+/* The whole text in one color */
+static void set_color(color_spans_t *colors, int color, int len) {
+    colors->count = len > 0;
+    colors->spans[0].color = (uint8_t)color;
+    colors->spans[0].len = (uint8_t)len;
+}
+
+/* ── Metadata ────────────────────────────────────────────────── */
+
+/* "0".."255" for every octet value: three characters plus a length */
+typedef struct {
+    char text[3];
+    uint8_t len;
+} octet_text_t;
+
+static octet_text_t octet_lut[256];
+
+/* "00".."99" */
+static char digit_pairs[200];
+
+static void build_lookup_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        octet_text_t *o = &octet_lut[i];
+        if (i >= 100) {
+            o->text[0] = '0' + i / 100;
+            o->text[1] = '0' + i / 10 % 10;
+            o->text[2] = '0' + i % 10;
+            o->len = 3;
+        } else if (i >= 10) {
+            o->text[0] = '0' + i / 10;
+            o->text[1] = '0' + i % 10;
+            o->len = 2;
+        } else {
+            o->text[0] = '0' + i;
+            o->len = 1;
+        }
+    }
+    for (int i = 0; i < 100; i++) {
+        digit_pairs[i * 2]     = '0' + i / 10;
+        digit_pairs[i * 2 + 1] = '0' + i % 10;
+    }
+}
+
+/* Dotted quad; the output buffer needs 16 bytes of room: every octet
+ * copies three digits and a dot, whatever its length */
+static int put_ipv4(char *out, const uint8_t *addr) {
+    int pos = 0;
+    for (int i = 0; i < 4; i++) {
+        const octet_text_t *o = &octet_lut[addr[i]];
+        /* Copy all three bytes and advance by the real length */
+        memcpy(out + pos, o->text, 3);
+        pos += o->len;
+        out[pos] = '.';
+        pos += i < 3;
+    }
+    return pos;
+}
+
+/* Decimal port (1..65535); the output buffer needs 5 bytes of room */
+static int put_port(char *out, uint16_t port) {
+    char digits[10] = "";  /* five digits, then slack for the fixed-size copy */
+    digits[0] = '0' + port / 10000;
+    memcpy(digits + 1, digit_pairs + (port / 100 % 100) * 2, 2);
+    memcpy(digits + 3, digit_pairs + (port % 100) * 2, 2);
+
+    int len = 1 + (port >= 10) + (port >= 100) + (port >= 1000) + (port >= 10000);
+    memcpy(out, digits + 5 - len, 5);
+    return len;
+}
+
+/* Hostname if --names has one cached, else the address. Sets *pending
+ * while a lookup is still outstanding. */
+static int put_addr(char *out, const packet_record_t *rec, const uint8_t *addr, int *pending) {
+    int family = rec->kind == PKT_KIND_IPV6 ? AF_INET6 : AF_INET;
+
+    if (resolve_names) {
+        int state = resolver_lookup(family, addr, out, RESOLVER_NAME_LEN);
+        if (state == RESOLVE_OK) return (int)strlen(out);
+        if (state == RESOLVE_PENDING) *pending = 1;
+    }
+
+    if (family == AF_INET6) {
+        /* Zero compression rules make inet_ntop worth keeping here */
+        inet_ntop(AF_INET6, addr, out, INET6_ADDRSTRLEN);
+        return (int)strlen(out);
+    }
+    return put_ipv4(out, addr);
+}
+
+static int put_str(char *out, const char *s, int len) {
+    memcpy(out, s, len);
+    return len;
+}
+
+/* Longest text put_addr() can produce, terminator included */
+#define ADDR_TEXT_MAX (RESOLVER_NAME_LEN > INET6_ADDRSTRLEN ? RESOLVER_NAME_LEN : INET6_ADDRSTRLEN)
+
+/* Format packet info and its color runs */
+int format_packet_meta(const packet_record_t *rec, char *text, color_spans_t *colors,
+                       int *names_pending) {
+    /* Worst case: "ICMP6 " + two addresses + ports + " > ", with slack
+     * for the fixed-width copies above */
+    char buf[2 * ADDR_TEXT_MAX + 32];
+    int pending = 0;
+    int pos = 0;
+
+    if (rec->kind == PKT_KIND_ARP) {
+        pos += put_str(buf + pos, "ARP", 3);
+    } else {
+        switch (rec->protocol) {
+            case IPPROTO_TCP:    pos += put_str(buf + pos, "TCP", 3); break;
+            case IPPROTO_UDP:    pos += put_str(buf + pos, "UDP", 3); break;
+            case IPPROTO_ICMP:   pos += put_str(buf + pos, "ICMP", 4); break;
+            case IPPROTO_ICMPV6: pos += put_str(buf + pos, "ICMP6", 5); break;
+            default:
+                if (rec->kind == PKT_KIND_IPV6) pos += put_str(buf + pos, "IP6", 3);
+                else                            pos += put_str(buf + pos, "IP", 2);
+                break;
+        }
+    }
+    buf[pos++] = ' ';
+
+    pos += put_addr(buf + pos, rec, rec->src, &pending);
+    if (rec->src_port > 0) {
+        buf[pos++] = ':';
+        pos += put_port(buf + pos, rec->src_port);
+    }
+
+    pos += put_str(buf + pos, " > ", 3);
+
+    pos += put_addr(buf + pos, rec, rec->dst, &pending);
+    if (rec->dst_port > 0) {
+        buf[pos++] = ':';
+        pos += put_port(buf + pos, rec->dst_port);
+    }
+
+    if (pos > MAX_INFO_LEN - 1) pos = MAX_INFO_LEN - 1;
+    memcpy(text, buf, pos);
+    text[pos] = '\0';
+
+    set_color(colors, rec->is_inbound ? COLOR_INBOUND : COLOR_OUTBOUND, pos);
+
+    if (names_pending) *names_pending = pending;
+    return pos;
+}
+
+/* ── Hex ─────────────────────────────────────────────────────── */
+
+/* Each kernel writes "xx " for every input byte (3 * n characters,
+ * trailing space included) and returns how many bytes it consumed; the
+ * vector kernels only take whole blocks and leave the tail to the
+ * scalar one. */
+typedef int (*hex_kernel_fn)(const uint8_t *in, int n, char *out);
+
+static int hex_scalar(const uint8_t *in, int n, char *out) {
+    for (int i = 0; i < n; i++) {
+        out[i * 3]     = hexchars[in[i] >> 4];
+        out[i * 3 + 1] = hexchars[in[i] & 0x0f];
+        out[i * 3 + 2] = ' ';
+    }
+    return n;
+}
+
+#ifdef FORMAT_HAVE_X86
+
+/* Spread 16 digit pairs (lo: pairs 0-7, hi: pairs 8-15) over 48 output
+ * bytes with a space after each pair */
+__attribute__((target("ssse3")))
+static inline void hex_spread_16(__m128i lo, __m128i hi, char *out) {
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const char z = (char)0x80;  /* pshufb: zero this byte */
+
+    /* out[0..15]: p0 p1 p2 p3 p4 p5.h, all from lo */
+    const __m128i s0 = _mm_setr_epi8(0, 1, z, 2, 3, z, 4, 5, z, 6, 7, z, 8, 9, z, 10);
+    /* out[16..31]: p5.l p6 .. p10 straddles lo (bytes 11-15) and hi (0-5) */
+    const __m128i s1a = _mm_setr_epi8(11, z, 12, 13, z, 14, 15, z, z, z, z, z, z, z, z, z);
+    const __m128i s1b = _mm_setr_epi8(z, z, z, z, z, z, z, z, 0, 1, z, 2, 3, z, 4, 5);
+    /* out[32..47]: p11 .. p15 from hi (bytes 6-15) */
+    const __m128i s2 = _mm_setr_epi8(z, 6, 7, z, 8, 9, z, 10, 11, z, 12, 13, z, 14, 15, z);
+
+    /* Zeroed positions are exactly the separators, so max() fills them */
+    __m128i o0 = _mm_max_epu8(_mm_shuffle_epi8(lo, s0), spaces);
+    __m128i o1 = _mm_max_epu8(_mm_or_si128(_mm_shuffle_epi8(lo, s1a),
+                                           _mm_shuffle_epi8(hi, s1b)), spaces);
+    __m128i o2 = _mm_max_epu8(_mm_shuffle_epi8(hi, s2), spaces);
+
+    _mm_storeu_si128((__m128i *)out, o0);
+    _mm_storeu_si128((__m128i *)(out + 16), o1);
+    _mm_storeu_si128((__m128i *)(out + 32), o2);
+}
+
+__attribute__((target("ssse3")))
+static int hex_ssse3(const uint8_t *in, int n, char *out) {
+    const __m128i lut  = _mm_loadu_si128((const __m128i *)hexchars);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        hex_spread_16(_mm_unpacklo_epi8(hi, lo), _mm_unpackhi_epi8(hi, lo), out + i * 3);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int hex_avx2(const uint8_t *in, int n, char *out) {
+    const __m256i lut  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hexchars));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v  = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        /* Unpacks stay within 128-bit lanes: lane 0 holds input bytes
+         * 0-15, lane 1 bytes 16-31 */
+        __m256i pairs_lo = _mm256_unpacklo_epi8(hi, lo);
+        __m256i pairs_hi = _mm256_unpackhi_epi8(hi, lo);
+        hex_spread_16(_mm256_castsi256_si128(pairs_lo),
+                      _mm256_castsi256_si128(pairs_hi), out + i * 3);
+        hex_spread_16(_mm256_extracti128_si256(pairs_lo, 1),
+                      _mm256_extracti128_si256(pairs_hi, 1), out + i * 3 + 48);
+    }
+
+    /* One 16-byte block may remain */
+    return i + hex_ssse3(in + i, n - i, out + i * 3);
+}
+
+#endif /* FORMAT_HAVE_X86 */
+
+static hex_kernel_fn hex_kernel = hex_scalar;
+static const char *hex_kernel_name = "scalar";
+
+void format_init(void) {
+    build_lookup_tables();
+
+#ifdef FORMAT_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        hex_kernel = hex_avx2;
+        hex_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        hex_kernel = hex_ssse3;
+        hex_kernel_name = "ssse3";
+    }
+#endif
+}
+
+const char *format_hex_kernel(void) {
+    return hex_kernel_name;
+}
+
+/* Format the payload prefix as a hex-only stream */
+int format_packet_hex(const packet_record_t *rec, char *text, color_spans_t *colors) {
+    /* 3 characters per byte must fit with the terminator */
+    _Static_assert(HEX_PAYLOAD_MAX * 3 <= MAX_INFO_LEN, "hex stream overflows text");
+
+    int n = rec->payload_len;
+    if (n == 0) {
+        text[0] = '\0';
+        colors->count = 0;
+        return 0;
+    }
+
+    int done = hex_kernel(rec->payload, n, text);
+    hex_scalar(rec->payload + done, n - done, text + done * 3);
+
+    /* Drop the trailing separator */
+    int pos = n * 3 - 1;
+    text[pos] = '\0';
+
+    set_color(colors, rec->is_inbound ? COLOR_INBOUND : COLOR_OUTBOUND, pos);
+    return pos;
+}
@@ -0,0 +1,47 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "capture.h"
+
+/* Configuration */
+#define MAX_COLOR_SPANS  4   /* color runs a formatted text may use */
+
+/* A run of characters drawn in one color pair */
+typedef struct {
+    uint8_t color;           /* COLOR_* */
+    uint8_t len;             /* text is shorter than MAX_INFO_LEN */
+} color_span_t;
+
+typedef struct {
+    uint8_t count;
+    color_span_t spans[MAX_COLOR_SPANS];
+} color_spans_t;
+
+/* Color pair of character idx (the last run's color past the end) */
+static inline int color_at(const color_spans_t *colors, int idx) {
+    for (int i = 0; i < colors->count; i++) {
+        if (idx < colors->spans[i].len) return colors->spans[i].color;
+        idx -= colors->spans[i].len;
+    }
+    return colors->count ? colors->spans[colors->count - 1].color : COLOR_FADING;
+}
+
+/* Build lookup tables and pick the fastest hex kernel the CPU supports.
+ * Call once before formatting anything. */
+void format_init(void);
+
+/* Name of the hex kernel format_init() selected */
+const char *format_hex_kernel(void);
+
+/* Write "PROTO src:port > dst:port" for a record into text and colors.
+ * text must hold MAX_INFO_LEN bytes; returns the length written. With
+ * --names, cached hostnames replace addresses, and *names_pending (may
+ * be NULL) is set if a lookup is still outstanding. */
+int format_packet_meta(const packet_record_t *rec, char *text, color_spans_t *colors,
+                       int *names_pending);
+
+/* Write the payload prefix as space-separated hex bytes.
+ * Returns the length written (0 if the record carries no payload). */
+int format_packet_hex(const packet_record_t *rec, char *text, color_spans_t *colors);
+
+#endif /* FORMAT_H */
@@ -0,0 +1,105 @@
+#include "latency.h"
+#include "metrics.h"
+#include "simulation.h"
+
+#include <time.h>
+
+/* Globals */
+latency_histogram_t latency_stages[LATENCY_STAGES];
+const char *const latency_stage_names[LATENCY_STAGES] = {
+    "capture", "queue", "display", "total"
+};
+int latency_overlay = 0;                       /* set by --latency */
+volatile sig_atomic_t latency_dump_requested = 0;
+
+uint64_t latency_now_us(void) {
+    if (simulation) return simulation_now_us();
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int bucket_index(uint64_t us) {
+    if (us < LATENCY_SUB_BUCKETS) return (int)us;
+
+    int exponent = 63 - __builtin_clzll(us);
+    if (exponent > LATENCY_MAX_EXPONENT) return LATENCY_BUCKETS - 1;
+
+    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS
+         + (int)((us >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/* Largest value that lands in a bucket */
+static uint64_t bucket_upper(int idx) {
+    if (idx < LATENCY_SUB_BUCKETS) return (uint64_t)idx;
+
+    int shift = idx / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(LATENCY_SUB_BUCKETS + idx % LATENCY_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void latency_histogram_add(latency_histogram_t *h, uint64_t us) {
+    counter_add(&h->buckets[bucket_index(us)], 1);
+    counter_add(&h->count, 1);
+    counter_add(&h->sum_us, us);
+}
+
+void latency_record(int stage, uint64_t start_us, uint64_t end_us) {
+    latency_histogram_add(&latency_stages[stage], end_us > start_us ? end_us - start_us : 0);
+}
+
+uint64_t latency_quantile(int stage, double q) {
+    return latency_histogram_quantile(&latency_stages[stage], q);
+}
+
+uint64_t latency_histogram_quantile(latency_histogram_t *h, double q) {
+    /* Total the buckets themselves so a concurrent writer can't leave
+     * the walk short of its target */
+    unsigned long total = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        total += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    if (total == 0) return 0;
+
+    unsigned long target = (unsigned long)(q * total);
+    if (target < 1) target = 1;
+
+    unsigned long seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= target) return bucket_upper(i);
+    }
+    return bucket_upper(LATENCY_BUCKETS - 1);
+}
+
+void latency_format(char *buf, size_t len, uint64_t us) {
+    if (us < 1000) {
+        snprintf(buf, len, "%luus", (unsigned long)us);
+    } else if (us < 1000000) {
+        snprintf(buf, len, "%lums", (unsigned long)(us / 1000));
+    } else {
+        snprintf(buf, len, "%.1fs", us / 1e6);
+    }
+}
+
+void latency_print(FILE *f) {
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    static const char *const labels[] = { "p50", "p99", "p99.9" };
+
+    fprintf(f, "Latency (packet to pixel):\n");
+    for (int s = 0; s < LATENCY_STAGES; s++) {
+        unsigned long count = latency_stages[s].count;
+        fprintf(f, "  %-8s %10lu samples", latency_stage_names[s], count);
+        if (count > 0) {
+            for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+                char value[16];
+                latency_format(value, sizeof(value), latency_quantile(s, quantiles[q]));
+                fprintf(f, "  %s %7s", labels[q], value);
+            }
+        }
+        fputc('\n', f);
+    }
+    fflush(f);
+}
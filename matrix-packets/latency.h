@@ -0,0 +1,60 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+
+/* Configuration */
+#define LATENCY_SUB_BUCKET_BITS  4    /* 16 buckets per power of two: ~6% precision */
+#define LATENCY_MAX_EXPONENT     27   /* values up to 2^28 us (about 4.5 minutes) */
+
+#define LATENCY_SUB_BUCKETS  (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS      ((LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 2) \
+                              * LATENCY_SUB_BUCKETS)
+
+/* Stages a packet passes through on its way to the screen */
+#define LATENCY_CAPTURE  0   /* kernel timestamp -> queued by the capture thread */
+#define LATENCY_QUEUE    1   /* queued -> folded into a stream by the frame loop */
+#define LATENCY_DISPLAY  2   /* folded into a stream -> first commit showing it */
+#define LATENCY_TOTAL    3   /* kernel timestamp -> first commit showing it */
+#define LATENCY_STAGES   4
+
+/* HDR-style log-linear histogram of microsecond values: exact below
+ * LATENCY_SUB_BUCKETS, then LATENCY_SUB_BUCKETS buckets per power of
+ * two. Written only by the frame loop (counter_add), read by anyone. */
+typedef struct {
+    atomic_ulong buckets[LATENCY_BUCKETS];
+    atomic_ulong count;
+    atomic_ulong sum_us;
+} latency_histogram_t;
+
+/* Globals (defined in latency.c) */
+extern latency_histogram_t latency_stages[LATENCY_STAGES];
+extern const char *const latency_stage_names[LATENCY_STAGES];
+extern int latency_overlay;
+extern volatile sig_atomic_t latency_dump_requested;
+
+/* Wall-clock microseconds, the clock pcap timestamps use (the frame
+ * clock in a simulation) */
+uint64_t latency_now_us(void);
+
+/* Add end - start to a stage (clamped at 0: the clock can step) */
+void latency_record(int stage, uint64_t start_us, uint64_t end_us);
+
+/* Upper bound of the bucket holding quantile q (0..1), or 0 if empty */
+uint64_t latency_quantile(int stage, double q);
+
+/* The same for any histogram (frame pacing keeps its own) */
+void latency_histogram_add(latency_histogram_t *h, uint64_t us);
+uint64_t latency_histogram_quantile(latency_histogram_t *h, double q);
+
+/* "850us", "42ms" or "1.3s" */
+void latency_format(char *buf, size_t len, uint64_t us);
+
+/* p50/p99/p99.9 per stage (on SIGUSR1 and in the exit summary) */
+void latency_print(FILE *f);
+
+#endif /* LATENCY_H */
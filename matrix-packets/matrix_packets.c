@@ -16,75 +16,295 @@
 #include <signal.h>
 #include <time.h>
 #include <poll.h>
-#include <pthread.h>
 #include <grp.h>
+#include <getopt.h>
 
 #include "capture.h"
 #include "streams.h"
+#include "format.h"
+#include "flows.h"
+#include "admit.h"
+#include "columns.h"
+#include "resolver.h"
+#include "metrics.h"
+#include "latency.h"
+#include "simulation.h"
+#include "profile.h"
 #include "render_wayland.h"
 
-#define FRAME_DELAY_US 100000  /* 100ms = 10 FPS */
+#define FRAME_DELAY_US 100000  /* 100ms = 10 FPS, unless --fps is given */
+#define FRAME_RATE_MAX 1000    /* highest --fps (the output refresh caps it too) */
 
 /* Globals */
 volatile sig_atomic_t running = 1;
+int profiling = 0;
 
 static void signal_handler(int sig) {
-    (void)sig;
+    if (sig == SIGUSR1) {
+        latency_dump_requested = 1;
+        return;
+    }
     running = 0;
 }
 
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options] [interface... | all]\n"
+        "  -b, --backend NAME   capture backend: pcap (default) or tpacket\n"
+        "  -a, --adaptive       sample in the kernel while the display falls behind\n"
+        "  -i, --immediate      deliver packets without kernel buffering (pcap backend)\n"
+        "  -w, --workers N      capture threads per interface, joined by PACKET_FANOUT (default 1)\n"
+        "  -f, --fanout MODE    how packets are spread over workers: hash (default) or cpu\n"
+        "  -r, --read FILE      replay a pcap/pcapng file instead (\"-\" for stdin)\n"
+        "  -s, --speed X        replay speed multiplier, 0 = as fast as possible (default 1)\n"
+        "  -S, --seed N         seed stream placement; with --read, simulate on the\n"
+        "                       replay's clock so runs are repeatable frame for frame\n"
+        "  -n, --names          show hostnames (reverse DNS) instead of addresses\n"
+        "  -m, --metrics FILE   rewrite FILE with Prometheus metrics every second\n"
+        "  -z, --zones          give encrypted metadata, encrypted hex and cleartext\n"
+        "                       streams their own third of the screen\n"
+        "  -l, --latency        show packet-to-pixel latency in the stats bar\n"
+        "  -F, --fps N          target frame rate, capped at the output refresh (default 10)\n"
+        "  -t, --render-threads N\n"
+        "                       threads repainting each frame (default 1)\n"
+        "  -p, --profile        measure per-stage costs and print them on exit\n"
+        "  -h, --help           show this help\n",
+        prog);
+}
+
+static int parse_backend(const char *name) {
+    if (strcmp(name, "pcap") == 0)    return CAPTURE_BACKEND_PCAP;
+    if (strcmp(name, "tpacket") == 0) return CAPTURE_BACKEND_TPACKET;
+    return -1;
+}
+
 int main(int argc, char *argv[]) {
     char errbuf[PCAP_ERRBUF_SIZE];
-    pthread_t capture_tid;
-
-    /* Handle arguments */
-    if (argc > 1) {
-        net_interface = strdup(argv[1]);
-        if (!net_interface) { perror("strdup"); return 1; }
-    } else {
-        net_interface = detect_interface();
+    const char *replay_file = NULL;
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    int seeded = 0;
+    long frame_delay_us = FRAME_DELAY_US;
+
+    static const struct option long_opts[] = {
+        { "backend",  required_argument, NULL, 'b' },
+        { "adaptive", no_argument,       NULL, 'a' },
+        { "immediate", no_argument,      NULL, 'i' },
+        { "workers",  required_argument, NULL, 'w' },
+        { "fanout",   required_argument, NULL, 'f' },
+        { "read",     required_argument, NULL, 'r' },
+        { "speed",    required_argument, NULL, 's' },
+        { "seed",     required_argument, NULL, 'S' },
+        { "names",    no_argument,       NULL, 'n' },
+        { "metrics",  required_argument, NULL, 'm' },
+        { "zones",    no_argument,       NULL, 'z' },
+        { "latency",  no_argument,       NULL, 'l' },
+        { "fps",      required_argument, NULL, 'F' },
+        { "render-threads", required_argument, NULL, 't' },
+        { "profile",  no_argument,       NULL, 'p' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:aiw:f:r:s:S:nm:zlF:t:ph", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                capture_backend = parse_backend(optarg);
+                if (capture_backend < 0) {
+                    fprintf(stderr, "Unknown capture backend: %s\n", optarg);
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adaptive_sampling = 1;
+                break;
+            case 'i':
+                capture_immediate = 1;
+                break;
+            case 'w': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*end != '\0' || n < 1 || n > MAX_CAPTURE_SOURCES) {
+                    fprintf(stderr, "Invalid worker count: %s (1-%d)\n",
+                            optarg, MAX_CAPTURE_SOURCES);
+                    return 1;
+                }
+                fanout_workers = (int)n;
+                break;
+            }
+            case 'f':
+                if (strcmp(optarg, "hash") == 0) {
+                    fanout_mode = CAPTURE_FANOUT_HASH;
+                } else if (strcmp(optarg, "cpu") == 0) {
+                    fanout_mode = CAPTURE_FANOUT_CPU;
+                } else {
+                    fprintf(stderr, "Unknown fanout mode: %s\n", optarg);
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r':
+                replay_file = optarg;
+                break;
+            case 's': {
+                char *end;
+                replay_speed = strtod(optarg, &end);
+                if (*end != '\0' || replay_speed < 0) {
+                    fprintf(stderr, "Invalid replay speed: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'S': {
+                char *end;
+                seed = strtoull(optarg, &end, 0);
+                if (*end != '\0' || *optarg == '\0') {
+                    fprintf(stderr, "Invalid seed: %s\n", optarg);
+                    return 1;
+                }
+                seeded = 1;
+                break;
+            }
+            case 'n':
+                resolve_names = 1;
+                break;
+            case 'm':
+                metrics_path = optarg;
+                break;
+            case 'z':
+                column_zones = 1;
+                break;
+            case 'l':
+                latency_overlay = 1;
+                break;
+            case 'F': {
+                char *end;
+                long fps = strtol(optarg, &end, 10);
+                if (*end != '\0' || fps < 1 || fps > FRAME_RATE_MAX) {
+                    fprintf(stderr, "Invalid frame rate: %s (1-%d)\n", optarg, FRAME_RATE_MAX);
+                    return 1;
+                }
+                frame_delay_us = 1000000 / fps;
+                break;
+            }
+            case 't': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*end != '\0' || n < 1 || n > RENDER_THREADS_MAX) {
+                    fprintf(stderr, "Invalid render thread count: %s (1-%d)\n",
+                            optarg, RENDER_THREADS_MAX);
+                    return 1;
+                }
+                render_threads = (int)n;
+                break;
+            }
+            case 'p':
+                profiling = 1;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
     }
 
     printf("Matrix Packet Visualizer (Wayland)\n");
-    printf("Using interface: %s\n", net_interface);
 
-    /* Get local IP addresses */
-    get_local_ips(net_interface);
-    printf("Detected %d local IP(s)\n", local_ip_count);
-    printf("Starting capture (requires root)...\n");
+    /* Handle arguments: a replay file, the named interfaces ("all" for
+     * every active one), or the busiest interface */
+    if (replay_file) {
+        adaptive_sampling = 0;  /* the sampling clause only runs in the kernel */
+        fanout_workers = 1;     /* a file has a single reader */
+        capture_source_t *src = capture_add_source(replay_file);
+        if (capture_open_file(src, errbuf) != 0) {
+            fprintf(stderr, "pcap_open_offline failed: %s\n", errbuf);
+            return 1;
+        }
+        /* Replays have no interface, so every local address counts */
+        get_local_ips(src, NULL);
+        simulation = seeded;
+        if (simulation)
+            printf("Simulating: %s on its own clock\n", replay_file);
+        else if (replay_speed > 0)
+            printf("Replaying: %s at %gx speed\n", replay_file, replay_speed);
+        else
+            printf("Replaying: %s as fast as possible\n", replay_file);
+    } else {
+        char names[MAX_CAPTURE_SOURCES][SOURCE_NAME_LEN];
+        int name_count = 0;
+
+        for (int i = optind; i < argc && name_count < MAX_CAPTURE_SOURCES; i++) {
+            if (strcmp(argv[i], "all") == 0) {
+                name_count += detect_active_interfaces(names + name_count,
+                                                       MAX_CAPTURE_SOURCES - name_count);
+            } else {
+                snprintf(names[name_count++], SOURCE_NAME_LEN, "%s", argv[i]);
+            }
+        }
+        if (name_count == 0) {
+            char *best = detect_interface();
+            snprintf(names[name_count++], SOURCE_NAME_LEN, "%s", best);
+            free(best);
+        }
+
+        printf("Starting capture (requires root)...\n");
+        for (int i = 0; i < name_count; i++) {
+            for (int w = 0; w < fanout_workers; w++) {
+                capture_source_t *src = capture_add_source(names[i]);
+                if (!src) {
+                    fprintf(stderr, "Too many capture threads (max %d)\n", MAX_CAPTURE_SOURCES);
+                    capture_close();
+                    return 1;
+                }
+                src->fanout_index = w;
+                if (fanout_workers > 1) {
+                    snprintf(src->label, sizeof(src->label), "%s/%d", names[i], w);
+                }
+
+                if (capture_open_live(src, errbuf) != 0) {
+                    fprintf(stderr, "pcap_open_live %s failed: %s\n", names[i], errbuf);
+                    fprintf(stderr, "Are you running as root or with CAP_NET_RAW?\n");
+                    capture_close();
+                    return 1;
+                }
+                get_local_ips(src, src->name);
+            }
+
+            capture_source_t *src = capture_sources[capture_source_count - 1];
+            if (fanout_workers > 1) {
+                printf("Using interface: %s (%s, %d local IP(s), %d %s fanout workers)\n",
+                       src->name, capture_backend_name(src->backend), src->local_ip_count,
+                       fanout_workers, fanout_mode == CAPTURE_FANOUT_CPU ? "cpu" : "hash");
+            } else {
+                printf("Using interface: %s (%s, %d local IP(s))\n", src->name,
+                       capture_backend_name(src->backend), src->local_ip_count);
+            }
+        }
+    }
 
     /* Set up signal handlers */
     struct sigaction sa = { .sa_handler = signal_handler, .sa_flags = 0 };
     sigemptyset(&sa.sa_mask);
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    /* Block them everywhere except inside the main loop's ppoll(), so the
+     * threads started below inherit the block and a signal always wakes
+     * the frame loop, even while it sleeps with nothing on screen */
+    sigset_t handled, poll_mask;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGTERM);
+    sigaddset(&handled, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &handled, &poll_mask);
 
     /* Ignore SIGPIPE (Wayland socket can trigger it) */
     signal(SIGPIPE, SIG_IGN);
 
-    /* Initialize ring buffer */
-    ring_buffer_init(&ring_buffer);
-
-    /* Open pcap handle */
-    pcap_handle = pcap_open_live(net_interface, MAX_PACKET_SIZE, 0, PCAP_TIMEOUT_MS, errbuf);
-    if (!pcap_handle) {
-        fprintf(stderr, "pcap_open_live failed: %s\n", errbuf);
-        fprintf(stderr, "Are you running as root or with CAP_NET_RAW?\n");
-        return 1;
-    }
-
-    /* Apply BPF filter */
-    struct bpf_program fp;
-    if (pcap_compile(pcap_handle, &fp, "ip", 1, PCAP_NETMASK_UNKNOWN) == 0) {
-        pcap_setfilter(pcap_handle, &fp);
-        pcap_freecode(&fp);
-    }
-
-    /* Set non-blocking mode */
-    if (pcap_setnonblock(pcap_handle, 1, errbuf) < 0) {
-        fprintf(stderr, "Warning: could not set non-blocking mode: %s\n", errbuf);
-    }
-
     /* Drop root privileges after pcap is set up */
     if (geteuid() == 0) {
         uid_t real_uid = getuid();
@@ -92,36 +312,47 @@ int main(int argc, char *argv[]) {
         if (real_uid != 0) {
             if (setgroups(0, NULL) != 0) {
                 perror("setgroups");
-                pcap_close(pcap_handle);
+                capture_close();
                 return 1;
             }
             if (setgid(real_gid) != 0) {
                 perror("setgid");
-                pcap_close(pcap_handle);
+                capture_close();
                 return 1;
             }
             if (setuid(real_uid) != 0) {
                 perror("setuid");
-                pcap_close(pcap_handle);
+                capture_close();
                 return 1;
             }
             printf("Dropped privileges to uid=%d gid=%d\n", real_uid, real_gid);
         }
     }
 
-    /* Start capture thread */
-    if (pthread_create(&capture_tid, NULL, capture_thread, NULL) != 0) {
-        perror("pthread_create");
-        pcap_close(pcap_handle);
+    /* Start one capture thread per source */
+    struct timespec started_at;
+    clock_gettime(CLOCK_MONOTONIC, &started_at);
+    if (capture_start() != 0) {
+        running = 0;
+        capture_stop();
+        capture_close();
         return 1;
     }
 
+    if (resolve_names && resolver_start() != 0) {
+        resolve_names = 0;
+    }
+    if (metrics_path && metrics_start() != 0) {
+        metrics_path = NULL;
+    }
+
     /* Initialize Wayland surface on background layer */
     if (wayland_init() != 0) {
         fprintf(stderr, "Failed to initialize Wayland surface\n");
         running = 0;
-        pthread_join(capture_tid, NULL);
-        pcap_close(pcap_handle);
+        capture_stop();
+        metrics_stop();
+        capture_close();
         return 1;
     }
 
@@ -129,26 +360,62 @@ int main(int argc, char *argv[]) {
     int height_cells = wayland_get_height_cells();
     printf("Surface: %d x %d cells\n", width_cells, height_cells);
 
-    srand(time(NULL));
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    streams_seed(seed);
+    format_init();
     init_streams(width_cells);
 
-    unsigned long frame_count = 0;
-
-    /* Main loop: poll on Wayland fd, clock-gated frame updates */
+    /* Main loop: poll on the Wayland fd and the capture wakeup. A frame
+     * is due once the pacing interval has passed and the compositor has
+     * asked for one through the last commit's frame callback. */
     int wl_fd = wayland_get_fd();
     struct timespec next_frame;
     clock_gettime(CLOCK_MONOTONIC, &next_frame);
 
+    /* A simulation's frames run back to back on a clock that starts at
+     * the first packet and advances one frame interval per frame */
+    if (simulation) simulation_start(capture_replay_start());
+
     while (running) {
+        long interval_us = wayland_frame_interval(frame_delay_us);
+
         /* Compute ms until next frame is due */
         struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
         long wait_ms = (next_frame.tv_sec - now.tv_sec) * 1000
                      + (next_frame.tv_nsec - now.tv_nsec) / 1000000;
-        if (wait_ms < 0) wait_ms = 0;
+        if (wait_ms < 0 || simulation) wait_ms = 0;
+
+        /* Nothing on screen and nothing queued: sleep until a capture
+         * thread has packets instead of ticking empty frames */
+        int sleeping = !simulation && !streams_have_content() && capture_prepare_sleep();
+
+        /* Streams on screen but the compositor hasn't asked for a frame:
+         * wait for it, however long. A hidden or occluded output never
+         * asks, so the loop (and the streams) stay still. */
+        int waiting = !simulation && !sleeping && streams_have_content() &&
+                      !wayland_frame_ready();
+
+        /* The capture eventfd is only watched while sleeping: a wakeup
+         * that raced a sleep being abandoned can leave it readable, and
+         * polling it then would return at once every time */
+        struct pollfd pfds[2] = {
+            { .fd = wl_fd,              .events = POLLIN },
+            { .fd = capture_event_fd(), .events = POLLIN },
+        };
+        struct timespec timeout = { wait_ms / 1000, (wait_ms % 1000) * 1000000L };
+        ppoll(pfds, sleeping ? 2 : 1, sleeping || waiting ? NULL : &timeout, &poll_mask);
+
+        if (latency_dump_requested) {
+            latency_dump_requested = 0;
+            latency_print(stderr);
+        }
 
-        struct pollfd pfd = { .fd = wl_fd, .events = POLLIN };
-        poll(&pfd, 1, (int)wait_ms);
+        if (sleeping) {
+            capture_finish_sleep();
+            /* Start the first frame right away rather than on the old clock */
+            clock_gettime(CLOCK_MONOTONIC, &next_frame);
+        }
 
         /* Always dispatch Wayland events promptly */
         wayland_dispatch();
@@ -160,13 +427,15 @@ int main(int argc, char *argv[]) {
             resize_streams(width_cells, height_cells);
         }
 
-        /* Only tick streams and render at the target frame rate */
+        /* Only tick streams and render at the paced rate, and only while
+         * the compositor wants frames (nothing is drawn without content) */
         clock_gettime(CLOCK_MONOTONIC, &now);
-        if (now.tv_sec > next_frame.tv_sec ||
-            (now.tv_sec == next_frame.tv_sec && now.tv_nsec >= next_frame.tv_nsec)) {
+        int due = now.tv_sec > next_frame.tv_sec ||
+                  (now.tv_sec == next_frame.tv_sec && now.tv_nsec >= next_frame.tv_nsec);
+        if (simulation || (due && (!streams_have_content() || wayland_frame_ready()))) {
 
             /* Advance next deadline */
-            next_frame.tv_nsec += FRAME_DELAY_US * 1000L;
+            next_frame.tv_nsec += interval_us * 1000L;
             if (next_frame.tv_nsec >= 1000000000L) {
                 next_frame.tv_sec  += next_frame.tv_nsec / 1000000000L;
                 next_frame.tv_nsec %= 1000000000L;
@@ -178,27 +447,49 @@ int main(int argc, char *argv[]) {
                 next_frame = now;
             }
 
-            update_streams(height_cells, frame_count);
+            if (simulation) {
+                simulation_advance(frame_delay_us);
+                capture_sync_replay(simulation_now_us());
+            }
+            update_streams(height_cells);
 
             if (streams_have_content()) {
-                if (render_frame_wayland(frame_count) < 0) {
+                if (render_frame_wayland() < 0) {
                     break;
                 }
             }
 
-            frame_count++;
+            /* A finished replay exits once everything it queued has played out */
+            if (capture_done && capture_queued() == 0 &&
+                !streams_have_content()) {
+                break;
+            }
         }
     }
 
     /* Cleanup */
     running = 0;
-    pthread_join(capture_tid, NULL);
+    capture_stop();
+    if (resolve_names) resolver_stop();
 
     wayland_cleanup();
-    pcap_close(pcap_handle);
-    free(net_interface);
 
-    printf("\nCaptured %lu packets\n", packets_captured);
+    struct timespec stopped_at;
+    clock_gettime(CLOCK_MONOTONIC, &stopped_at);
+    capture_print_summary((stopped_at.tv_sec - started_at.tv_sec)
+                          + (stopped_at.tv_nsec - started_at.tv_nsec) / 1e9);
+    flow_print_summary();
+    admit_print_summary(stdout);
+    wayland_print_summary(stdout);
+    latency_print(stdout);
+    if (resolve_names) resolver_print_summary();
+    metrics_stop();
+    if (profiling) {
+        streams_print_profile();
+        wayland_print_profile();
+    }
+
+    capture_close();
 
     return 0;
 }
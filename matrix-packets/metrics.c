@@ -0,0 +1,201 @@
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* Globals */
+frame_counters_t frame_counters;
+const char *metrics_path = NULL;   /* set by --metrics */
+
+static pthread_t metrics_thread_id;
+static int metrics_started = 0;
+static int metrics_running = 0;
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t metrics_wake = PTHREAD_COND_INITIALIZER;
+
+static const char *const direction_names[TRAFFIC_DIRS] = { "in", "out" };
+static const char *const protocol_names[TRAFFIC_PROTOS] = { "tcp", "udp", "icmp", "other" };
+
+/* Label values escape backslash, quote and newline (replay paths can
+ * contain anything) */
+static void write_source_label(FILE *f, const capture_source_t *src) {
+    fputs("source=\"", f);
+    for (const char *p = src->label; *p; p++) {
+        if (*p == '\\' || *p == '"') fputc('\\', f);
+        if (*p == '\n') fputs("\\n", f);
+        else fputc(*p, f);
+    }
+    fputc('"', f);
+}
+
+/* One line per source for a per-source counter or gauge */
+#define WRITE_SOURCE_METRIC(f, metric, expr)                                  \
+    for (int i = 0; i < capture_source_count; i++) {                          \
+        const capture_source_t *src = capture_sources[i];                     \
+        fputs(metric "{", f);                                                 \
+        write_source_label(f, src);                                           \
+        fprintf(f, "} %lu\n", (unsigned long)(expr));                         \
+    }
+
+static void write_metrics(FILE *f) {
+    fprintf(f, "# HELP matrix_packets_total Packets delivered to the capture thread.\n");
+    fprintf(f, "# TYPE matrix_packets_total counter\n");
+    WRITE_SOURCE_METRIC(f, "matrix_packets_total", src->packets);
+
+    fprintf(f, "# HELP matrix_packets_filtered_total Packets the dissector could not show.\n");
+    fprintf(f, "# TYPE matrix_packets_filtered_total counter\n");
+    WRITE_SOURCE_METRIC(f, "matrix_packets_filtered_total", src->filtered);
+
+    fprintf(f, "# HELP matrix_kernel_drops_total Packets the kernel dropped before capture.\n");
+    fprintf(f, "# TYPE matrix_kernel_drops_total counter\n");
+    WRITE_SOURCE_METRIC(f, "matrix_kernel_drops_total", src->kernel_drops);
+
+    fprintf(f, "# HELP matrix_ring_overflows_total Packets dropped on a full queue.\n");
+    fprintf(f, "# TYPE matrix_ring_overflows_total counter\n");
+    WRITE_SOURCE_METRIC(f, "matrix_ring_overflows_total", src->ring.overflows);
+
+    fprintf(f, "# HELP matrix_ring_queued Records waiting for the frame loop.\n");
+    fprintf(f, "# TYPE matrix_ring_queued gauge\n");
+    WRITE_SOURCE_METRIC(f, "matrix_ring_queued",
+                        ring_buffer_count((ring_buffer_t *)&src->ring));
+
+    fprintf(f, "# HELP matrix_sample_rate Kernel sampling ratio (1 in N kept).\n");
+    fprintf(f, "# TYPE matrix_sample_rate gauge\n");
+    WRITE_SOURCE_METRIC(f, "matrix_sample_rate", src->sample_rate);
+
+    fprintf(f, "# HELP matrix_bytes_total Estimated wire bytes by direction and protocol.\n");
+    fprintf(f, "# TYPE matrix_bytes_total counter\n");
+    for (int i = 0; i < capture_source_count; i++) {
+        const capture_source_t *src = capture_sources[i];
+        for (int d = 0; d < TRAFFIC_DIRS; d++) {
+            for (int p = 0; p < TRAFFIC_PROTOS; p++) {
+                fputs("matrix_bytes_total{", f);
+                write_source_label(f, src);
+                fprintf(f, ",direction=\"%s\",protocol=\"%s\"} %lu\n",
+                        direction_names[d], protocol_names[p],
+                        (unsigned long)src->traffic[d][p].bytes);
+            }
+        }
+    }
+
+    fprintf(f, "# HELP matrix_streams_spawned_total Streams started on screen.\n");
+    fprintf(f, "# TYPE matrix_streams_spawned_total counter\n");
+    fprintf(f, "matrix_streams_spawned_total %lu\n",
+            (unsigned long)frame_counters.streams_spawned);
+
+    fprintf(f, "# HELP matrix_streams_offered_total Stream candidates offered for admission.\n");
+    fprintf(f, "# TYPE matrix_streams_offered_total counter\n");
+    fprintf(f, "matrix_streams_offered_total %lu\n",
+            (unsigned long)frame_counters.streams_offered);
+
+    fprintf(f, "# HELP matrix_streams_rejected_total Streams not started, by reason.\n");
+    fprintf(f, "# TYPE matrix_streams_rejected_total counter\n");
+    fprintf(f, "matrix_streams_rejected_total{reason=\"slot\"} %lu\n",
+            (unsigned long)frame_counters.streams_no_slot);
+    fprintf(f, "matrix_streams_rejected_total{reason=\"column\"} %lu\n",
+            (unsigned long)frame_counters.streams_no_column);
+    fprintf(f, "matrix_streams_rejected_total{reason=\"budget\"} %lu\n",
+            (unsigned long)frame_counters.streams_deferred);
+
+    fprintf(f, "# HELP matrix_frames_total Frames rendered, and skipped with no free buffer.\n");
+    fprintf(f, "# TYPE matrix_frames_total counter\n");
+    fprintf(f, "matrix_frames_total{result=\"rendered\"} %lu\n",
+            (unsigned long)frame_counters.frames_rendered);
+    fprintf(f, "matrix_frames_total{result=\"skipped\"} %lu\n",
+            (unsigned long)frame_counters.frames_skipped);
+
+    fprintf(f, "# HELP matrix_presentation_total Committed frames by wp_presentation outcome.\n");
+    fprintf(f, "# TYPE matrix_presentation_total counter\n");
+    fprintf(f, "matrix_presentation_total{result=\"presented\"} %lu\n",
+            (unsigned long)frame_counters.frames_presented);
+    fprintf(f, "matrix_presentation_total{result=\"discarded\"} %lu\n",
+            (unsigned long)frame_counters.frames_discarded);
+
+    fprintf(f, "# HELP matrix_latency_seconds Packet-to-pixel latency by stage.\n");
+    fprintf(f, "# TYPE matrix_latency_seconds summary\n");
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    for (int s = 0; s < LATENCY_STAGES; s++) {
+        const char *stage = latency_stage_names[s];
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            fprintf(f, "matrix_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                    stage, quantiles[q], latency_quantile(s, quantiles[q]) / 1e6);
+        }
+        fprintf(f, "matrix_latency_seconds_sum{stage=\"%s\"} %.6f\n",
+                stage, latency_stages[s].sum_us / 1e6);
+        fprintf(f, "matrix_latency_seconds_count{stage=\"%s\"} %lu\n",
+                stage, (unsigned long)latency_stages[s].count);
+    }
+}
+
+/* Write to a temporary file and rename it over the target, so scrapers
+ * (e.g. node_exporter's textfile collector) never see a partial file */
+static void write_metrics_file(void) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", metrics_path);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        perror(tmp_path);
+        return;
+    }
+    write_metrics(f);
+    if (fclose(f) != 0 || rename(tmp_path, metrics_path) != 0) {
+        perror(metrics_path);
+        remove(tmp_path);
+    }
+}
+
+static void *metrics_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&metrics_lock);
+    while (metrics_running) {
+        pthread_mutex_unlock(&metrics_lock);
+        write_metrics_file();
+        pthread_mutex_lock(&metrics_lock);
+
+        struct timespec due;
+        clock_gettime(CLOCK_REALTIME, &due);
+        due.tv_sec  += METRICS_INTERVAL_MS / 1000;
+        due.tv_nsec += (METRICS_INTERVAL_MS % 1000) * 1000000L;
+        if (due.tv_nsec >= 1000000000L) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000L;
+        }
+        while (metrics_running &&
+               pthread_cond_timedwait(&metrics_wake, &metrics_lock, &due) == 0) {
+        }
+    }
+    pthread_mutex_unlock(&metrics_lock);
+    return NULL;
+}
+
+int metrics_start(void) {
+    metrics_running = 1;
+    if (pthread_create(&metrics_thread_id, NULL, metrics_thread, NULL) != 0) {
+        perror("pthread_create");
+        metrics_running = 0;
+        return -1;
+    }
+    metrics_started = 1;
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (!metrics_started) return;
+
+    pthread_mutex_lock(&metrics_lock);
+    metrics_running = 0;
+    pthread_cond_signal(&metrics_wake);
+    pthread_mutex_unlock(&metrics_lock);
+
+    pthread_join(metrics_thread_id, NULL);
+    metrics_started = 0;
+
+    /* Final totals, after the capture threads have stopped */
+    write_metrics_file();
+}
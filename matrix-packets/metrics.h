@@ -0,0 +1,43 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+
+#include "capture.h"
+
+/* Configuration */
+#define METRICS_INTERVAL_MS  1000   /* how often the metrics file is rewritten */
+
+/* Counters bumped by a single thread and read by others. Each thread
+ * owns its own set (capture sources carry theirs; the frame loop uses
+ * frame_counters), so no cache line is shared between writers and the
+ * hot path needs no locked instructions. */
+static inline void counter_add(atomic_ulong *c, unsigned long n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+/* Frame loop counters */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong streams_spawned;
+    atomic_ulong streams_no_slot;      /* stream capacity reached */
+    atomic_ulong streams_no_column;    /* no free, spaced column */
+    atomic_ulong streams_offered;      /* candidates for a new stream */
+    atomic_ulong streams_deferred;     /* not admitted: over the per-frame budget */
+    atomic_ulong frames_rendered;
+    atomic_ulong frames_skipped;       /* both SHM buffers held by the compositor */
+    atomic_ulong frames_presented;     /* reported on screen by wp_presentation */
+    atomic_ulong frames_discarded;     /* replaced before reaching the screen */
+} frame_counters_t;
+
+/* Globals (defined in metrics.c) */
+extern frame_counters_t frame_counters;
+extern const char *metrics_path;
+
+/* Start the thread that rewrites metrics_path every METRICS_INTERVAL_MS */
+int metrics_start(void);
+
+/* Write a final snapshot and stop the thread */
+void metrics_stop(void);
+
+#endif /* METRICS_H */
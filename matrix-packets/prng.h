@@ -0,0 +1,46 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stdint.h>
+
+/* xoshiro256** (Blackman & Vigna): small, fast and seedable, so each
+ * subsystem can own a generator and replay its exact sequence */
+typedef struct {
+    uint64_t s[4];
+} prng_t;
+
+static inline uint64_t prng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Expand a 64-bit seed with splitmix64, as the xoshiro authors suggest;
+ * it never yields the all-zero state */
+static inline void prng_seed(prng_t *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+static inline uint64_t prng_next(prng_t *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = prng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = prng_rotl(s[3], 45);
+    return result;
+}
+
+/* Uniform-enough value in [0, n) by multiply-shift, without a division */
+static inline uint32_t prng_below(prng_t *rng, uint32_t n) {
+    return (uint32_t)(((prng_next(rng) >> 32) * n) >> 32);
+}
+
+#endif /* PRNG_H */
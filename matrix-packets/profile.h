@@ -0,0 +1,27 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Set by --profile (defined in matrix_packets.c). Hot paths only read the
+ * clock when it is set, so normal runs pay a single branch. */
+extern int profiling;
+
+/* Cheapest monotonic tick source: the TSC on x86, nanoseconds elsewhere */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_UNIT "cycles"
+static inline uint64_t profile_ticks(void) {
+    return __rdtsc();
+}
+#else
+#define PROFILE_UNIT "ns"
+static inline uint64_t profile_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#endif /* PROFILE_H */
@@ -1,6 +1,11 @@
 #define _GNU_SOURCE
 #include "render_wayland.h"
 #include "capture.h"
+#include "metrics.h"
+#include "latency.h"
+#include "simulation.h"
+#include "admit.h"
+#include "profile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,11 +15,36 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <limits.h>
+#include <stdint.h>
 #include <wayland-client.h>
 #include <cairo/cairo.h>
 #include <pango/pangocairo.h>
 
 #include "wlr-layer-shell-unstable-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+
+/* ── Cell grid ───────────────────────────────────────────────── */
+
+/* One cell of a frame: glyph in the low byte, span color in the high
+ * byte, 0 when empty */
+typedef uint16_t cell_t;
+#define CELL_HEAD  0x7f   /* head block: a glyph outside the atlas */
+
+/* What a frame shows, cell by cell. A column holds at most one stream,
+ * so its characters share one pixel offset below the cell rows; slot 0
+ * is the row partly above the top edge. */
+typedef struct {
+    cell_t *cells;     /* grid_slots per column, column by column */
+    int *offset;       /* per column, 0 .. cell_h - 1 */
+    int stats_x, stats_y, stats_w, stats_h;  /* stats bar, 0 wide if none */
+} cell_grid_t;
+
+/* Globals */
+int render_threads = 1;   /* set by --render-threads */
 
 /* ── SHM buffer ──────────────────────────────────────────────── */
 
@@ -23,6 +53,7 @@ typedef struct {
     void *data;
     size_t size;
     int busy;  /* 1 while compositor holds it */
+    cell_grid_t grid;  /* what its pixels show */
 } shm_buffer_t;
 
 /* ── Wayland state ───────────────────────────────────────────── */
@@ -33,6 +64,8 @@ static struct wl_compositor *compositor;
 static struct wl_shm        *shm;
 static struct wl_output     *output;
 static struct zwlr_layer_shell_v1   *layer_shell;
+static struct wp_presentation       *presentation;  /* optional */
+static int presentation_supported = 0;  /* outlives the binding for the summary */
 
 static struct wl_surface            *surface;
 static struct zwlr_layer_surface_v1 *layer_surface;
@@ -47,23 +80,56 @@ static int closed = 0;
 static int cell_w, cell_h;
 static int grid_cols, grid_rows;
 
-/* Per-column damage tracking */
-typedef struct {
-    int active;   /* stream present this frame */
-    int min_row;  /* topmost row touched */
-    int max_row;  /* bottommost row touched */
-} col_damage_t;
+static int grid_slots;   /* cell slots per column: grid_rows + 1 */
 
-static col_damage_t *col_dmg_prev = NULL;
-static col_damage_t *col_dmg_cur  = NULL;
+/* The frame being drawn, and the buffer last committed: diffing against
+ * the buffer to draw into repaints what that buffer missed, however
+ * many frames ago it was shown. Diffing against the committed one gives
+ * the compositor's damage. */
+static cell_grid_t frame_grid;
+static shm_buffer_t *shown_buf = NULL;
 
-/* Stats bar damage tracking */
-static int stats_prev_x, stats_prev_y, stats_prev_w, stats_prev_h;
+/* Pixels repainted, for --profile */
+static uint64_t repainted_pixels = 0;
+static unsigned long repainted_frames = 0;
 
 /* Font */
 #define FONT_FAMILY "monospace"
 #define FONT_SIZE   14
 
+/* Frame pacing */
+#define PRESENT_FEEDBACK_SLOTS  8   /* commits awaiting presentation feedback */
+#define PRESENT_IDLE_GAP        4   /* commits further apart (in frame intervals)
+                                       start a new run; jitter isn't measured
+                                       across the gap */
+
+static struct wl_callback *frame_callback = NULL;  /* set until the compositor
+                                                      wants the next frame */
+static uint64_t refresh_ns = 0;        /* output refresh period, 0 if unknown */
+static long pace_interval_us = 0;      /* from wayland_frame_interval() */
+
+/* Presentation feedback, measured on the compositor's clock */
+typedef struct {
+    struct wp_presentation_feedback *feedback;  /* NULL while free */
+    uint64_t commit_us;
+    unsigned long seq;
+    int continues;   /* committed on the heels of the previous frame */
+} present_slot_t;
+
+static present_slot_t present_slots[PRESENT_FEEDBACK_SLOTS];
+static clockid_t present_clock = CLOCK_MONOTONIC;
+static unsigned long commit_seq = 0;
+static uint64_t last_commit_us = 0;
+static unsigned long last_present_seq = 0;
+static uint64_t last_present_us = 0;
+
+static latency_histogram_t present_latency;    /* commit -> on screen */
+static latency_histogram_t present_interval;   /* between presented frames */
+static latency_histogram_t present_jitter;     /* |interval - pacing interval| */
+
+/* Time from clearing a buffer to committing it, with --profile */
+static latency_histogram_t render_times;
+
 /* ── helpers ─────────────────────────────────────────────────── */
 
 static int create_shm_file(size_t size) {
@@ -131,6 +197,189 @@ static shm_buffer_t *get_free_buffer(void) {
     return NULL;  /* both busy — skip frame */
 }
 
+static void free_grid(cell_grid_t *g) {
+    free(g->cells);
+    free(g->offset);
+    *g = (cell_grid_t){0};
+}
+
+static void alloc_grid(cell_grid_t *g) {
+    free_grid(g);
+    g->cells = calloc((size_t)grid_cols * grid_slots + 1, sizeof(cell_t));
+    g->offset = calloc((size_t)grid_cols + 1, sizeof(int));
+    if (!g->cells || !g->offset) {
+        fprintf(stderr, "Failed to allocate cell grid\n");
+        exit(1);
+    }
+}
+
+/* ── Frame pacing ────────────────────────────────────────────── */
+
+static uint64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void frame_done(void *data, struct wl_callback *cb, uint32_t time_ms) {
+    (void)data;
+    (void)time_ms;
+    wl_callback_destroy(cb);
+    frame_callback = NULL;
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = frame_done,
+};
+
+static void feedback_sync_output(void *data, struct wp_presentation_feedback *fb,
+        struct wl_output *out) {
+    (void)data;
+    (void)fb;
+    (void)out;
+}
+
+static void feedback_presented(void *data, struct wp_presentation_feedback *fb,
+        uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+        uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
+    (void)seq_hi;
+    (void)seq_lo;
+    (void)flags;
+    present_slot_t *slot = data;
+
+    uint64_t present_us = ((uint64_t)tv_sec_hi << 32 | tv_sec_lo) * 1000000
+                        + tv_nsec / 1000;
+    if (refresh) refresh_ns = refresh;
+
+    latency_histogram_add(&present_latency,
+                          present_us > slot->commit_us ? present_us - slot->commit_us : 0);
+
+    /* Interval and jitter only between back-to-back frames */
+    if (slot->continues && last_present_seq == slot->seq - 1 && present_us > last_present_us) {
+        uint64_t interval = present_us - last_present_us;
+        uint64_t target = (uint64_t)pace_interval_us;
+        latency_histogram_add(&present_interval, interval);
+        latency_histogram_add(&present_jitter,
+                              interval > target ? interval - target : target - interval);
+    }
+    last_present_seq = slot->seq;
+    last_present_us = present_us;
+
+    counter_add(&frame_counters.frames_presented, 1);
+    wp_presentation_feedback_destroy(fb);
+    slot->feedback = NULL;
+}
+
+static void feedback_discarded(void *data, struct wp_presentation_feedback *fb) {
+    present_slot_t *slot = data;
+    counter_add(&frame_counters.frames_discarded, 1);
+    wp_presentation_feedback_destroy(fb);
+    slot->feedback = NULL;
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+    .sync_output = feedback_sync_output,
+    .presented   = feedback_presented,
+    .discarded   = feedback_discarded,
+};
+
+/* Ask for the next frame callback and, if the compositor supports it,
+ * for feedback on when this commit reaches the screen */
+static void request_frame_events(void) {
+    frame_callback = wl_surface_frame(surface);
+    wl_callback_add_listener(frame_callback, &frame_listener, NULL);
+
+    uint64_t now_us = clock_us(present_clock);
+    int continues = last_commit_us > 0 && pace_interval_us > 0 &&
+                    now_us - last_commit_us < (uint64_t)(PRESENT_IDLE_GAP * pace_interval_us);
+    last_commit_us = now_us;
+    commit_seq++;
+
+    if (!presentation) return;
+    for (int i = 0; i < PRESENT_FEEDBACK_SLOTS; i++) {
+        present_slot_t *slot = &present_slots[i];
+        if (slot->feedback) continue;
+
+        slot->feedback = wp_presentation_feedback(presentation, surface);
+        slot->commit_us = now_us;
+        slot->seq = commit_seq;
+        slot->continues = continues;
+        wp_presentation_feedback_add_listener(slot->feedback, &feedback_listener, slot);
+        return;
+    }
+    /* Every slot still waiting: this frame goes unmeasured */
+}
+
+static void presentation_clock_id(void *data, struct wp_presentation *pres, uint32_t clk_id) {
+    (void)data;
+    (void)pres;
+    present_clock = (clockid_t)clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id,
+};
+
+/* ── output listener ─────────────────────────────────────────── */
+
+static void output_geometry(void *data, struct wl_output *out, int32_t x, int32_t y,
+        int32_t phys_w, int32_t phys_h, int32_t subpixel, const char *make,
+        const char *model, int32_t transform) {
+    (void)data;
+    (void)out;
+    (void)x;
+    (void)y;
+    (void)phys_w;
+    (void)phys_h;
+    (void)subpixel;
+    (void)make;
+    (void)model;
+    (void)transform;
+}
+
+static void output_mode(void *data, struct wl_output *out, uint32_t flags,
+        int32_t w, int32_t h, int32_t refresh_mhz) {
+    (void)data;
+    (void)out;
+    (void)w;
+    (void)h;
+    if ((flags & WL_OUTPUT_MODE_CURRENT) && refresh_mhz > 0) {
+        refresh_ns = 1000000000000ULL / (uint64_t)refresh_mhz;
+    }
+}
+
+static void output_done(void *data, struct wl_output *out) {
+    (void)data;
+    (void)out;
+}
+
+static void output_scale(void *data, struct wl_output *out, int32_t factor) {
+    (void)data;
+    (void)out;
+    (void)factor;
+}
+
+static void output_name(void *data, struct wl_output *out, const char *name) {
+    (void)data;
+    (void)out;
+    (void)name;
+}
+
+static void output_description(void *data, struct wl_output *out, const char *desc) {
+    (void)data;
+    (void)out;
+    (void)desc;
+}
+
+static const struct wl_output_listener output_listener = {
+    .geometry    = output_geometry,
+    .mode        = output_mode,
+    .done        = output_done,
+    .scale       = output_scale,
+    .name        = output_name,
+    .description = output_description,
+};
+
 /* ── layer-surface listener ──────────────────────────────────── */
 
 static void layer_surface_configure(void *data,
@@ -154,11 +403,13 @@ static void layer_surface_configure(void *data,
         grid_cols = pixel_width  / cell_w;
         grid_rows = pixel_height / cell_h;
 
-        /* (Re)allocate damage tracking */
-        free(col_dmg_prev);
-        free(col_dmg_cur);
-        col_dmg_prev = calloc(grid_cols, sizeof(col_damage_t));
-        col_dmg_cur  = calloc(grid_cols, sizeof(col_damage_t));
+        /* (Re)allocate cell grids: fresh buffers are all transparent,
+         * which an empty grid describes */
+        grid_slots = grid_rows + 1;
+        alloc_grid(&frame_grid);
+        alloc_grid(&buffers[0].grid);
+        alloc_grid(&buffers[1].grid);
+        shown_buf = NULL;
 
         reconfigured = 1;
     }
@@ -192,10 +443,15 @@ static void registry_global(void *data, struct wl_registry *reg,
         if (!output) {
             output = wl_registry_bind(reg, name, &wl_output_interface,
                     version < 4 ? version : 4);
+            wl_output_add_listener(output, &output_listener, NULL);
         }
     } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
         layer_shell = wl_registry_bind(reg, name,
                 &zwlr_layer_shell_v1_interface, version < 4 ? version : 4);
+    } else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+        presentation = wl_registry_bind(reg, name, &wp_presentation_interface, 1);
+        presentation_supported = 1;
+        wp_presentation_add_listener(presentation, &presentation_listener, NULL);
     }
 }
 
@@ -259,6 +515,430 @@ static rgb_t color_for_pair(int pair) {
     }
 }
 
+/* ── Glyph atlas ─────────────────────────────────────────────── */
+
+#define GLYPH_FIRST  0x20   /* printable ASCII: all stream text uses */
+#define GLYPH_LAST   0x7e
+#define GLYPH_COUNT  (GLYPH_LAST - GLYPH_FIRST + 1)
+
+/* Coverage of every printable character, rasterized once by Pango into
+ * an A8 strip of cells. The cell size depends only on the font, so a
+ * resize keeps it. */
+static uint8_t *atlas = NULL;
+static int atlas_stride = 0;
+
+/* The stats bar's layout, kept from startup */
+static PangoLayout *stats_layout = NULL;
+static PangoFontDescription *stats_font = NULL;
+
+/* Opaque ARGB32 components for every span color (indexed by its byte),
+ * plain and brightened for head blocks */
+typedef struct { uint8_t r, g, b; } rgb8_t;
+
+#define PALETTE_SIZE 256
+
+static rgb8_t palette[PALETTE_SIZE];
+static rgb8_t palette_head[PALETTE_SIZE];
+
+static uint8_t channel8(double v) {
+    if (v > 1.0) v = 1.0;
+    return (uint8_t)(v * 255.0 + 0.5);
+}
+
+static void build_glyph_atlas(void) {
+    int width = GLYPH_COUNT * cell_w;
+    cairo_surface_t *cs = cairo_image_surface_create(CAIRO_FORMAT_A8, width, cell_h);
+    cairo_t *cr = cairo_create(cs);
+
+    PangoLayout *layout = pango_cairo_create_layout(cr);
+    PangoFontDescription *desc = pango_font_description_from_string(FONT_FAMILY " " G_STRINGIFY(FONT_SIZE));
+    pango_layout_set_font_description(layout, desc);
+    cairo_set_source_rgba(cr, 1, 1, 1, 1);
+
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        char ch = (char)(GLYPH_FIRST + g);
+
+        /* Keep overhanging glyphs out of their neighbours' cells */
+        cairo_save(cr);
+        cairo_rectangle(cr, g * cell_w, 0, cell_w, cell_h);
+        cairo_clip(cr);
+        cairo_move_to(cr, g * cell_w, 0);
+        pango_layout_set_text(layout, &ch, 1);
+        pango_cairo_show_layout(cr, layout);
+        cairo_restore(cr);
+    }
+    cairo_surface_flush(cs);
+
+    atlas_stride = cairo_image_surface_get_stride(cs);
+    free(atlas);
+    atlas = malloc((size_t)atlas_stride * cell_h);
+    if (!atlas) {
+        fprintf(stderr, "Failed to allocate glyph atlas\n");
+        exit(1);
+    }
+    memcpy(atlas, cairo_image_surface_get_data(cs), (size_t)atlas_stride * cell_h);
+
+    pango_font_description_free(desc);
+    g_object_unref(layout);
+    cairo_destroy(cr);
+    cairo_surface_destroy(cs);
+
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        rgb_t clr = color_for_pair(i);
+        palette[i] = (rgb8_t){ channel8(clr.r), channel8(clr.g), channel8(clr.b) };
+        palette_head[i] = (rgb8_t){ channel8(clr.r * 1.3), channel8(clr.g * 1.3),
+                                    channel8(clr.b * 1.3) };
+    }
+}
+
+static void create_stats_layout(void) {
+    cairo_surface_t *tmp = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    cairo_t *cr = cairo_create(tmp);
+
+    stats_layout = pango_cairo_create_layout(cr);
+    stats_font = pango_font_description_from_string(FONT_FAMILY " " G_STRINGIFY(FONT_SIZE));
+    pango_layout_set_font_description(stats_layout, stats_font);
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(tmp);
+}
+
+/* x * a / 255, rounded, without a division */
+static inline uint32_t mul255(uint32_t x, uint32_t a) {
+    uint32_t t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+/* Composite a character's coverage in a solid color over the buffer
+ * (premultiplied OVER), clipped to the surface */
+static void blit_glyph(uint32_t *pixels, int x, int y, unsigned char ch, rgb8_t clr) {
+    if (ch < GLYPH_FIRST || ch > GLYPH_LAST) return;
+
+    int x0 = x < 0 ? -x : 0;
+    int y0 = y < 0 ? -y : 0;
+    int x1 = x + cell_w > pixel_width  ? pixel_width - x  : cell_w;
+    int y1 = y + cell_h > pixel_height ? pixel_height - y : cell_h;
+    uint32_t solid = 0xff000000u | (uint32_t)clr.r << 16 | (uint32_t)clr.g << 8 | clr.b;
+
+    const uint8_t *glyph = atlas + (ch - GLYPH_FIRST) * cell_w;
+    for (int gy = y0; gy < y1; gy++) {
+        const uint8_t *cov = glyph + (size_t)gy * atlas_stride;
+        uint32_t *dst = pixels + (size_t)(y + gy) * pixel_width + x;
+
+        for (int gx = x0; gx < x1; gx++) {
+            uint32_t a = cov[gx];
+            if (a == 0) continue;
+            if (a == 255) {
+                dst[gx] = solid;
+                continue;
+            }
+
+            uint32_t d = dst[gx];
+            uint32_t inv = 255 - a;
+            dst[gx] = (a + mul255(d >> 24, inv)) << 24
+                    | (mul255(clr.r, a) + mul255((d >> 16) & 0xff, inv)) << 16
+                    | (mul255(clr.g, a) + mul255((d >> 8) & 0xff, inv)) << 8
+                    | (mul255(clr.b, a) + mul255(d & 0xff, inv));
+        }
+    }
+}
+
+/* Opaque cell-sized block, clipped to the surface */
+static void fill_cell(uint32_t *pixels, int x, int y, rgb8_t clr) {
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + cell_w > pixel_width  ? pixel_width  : x + cell_w;
+    int y1 = y + cell_h > pixel_height ? pixel_height : y + cell_h;
+    uint32_t solid = 0xff000000u | (uint32_t)clr.r << 16 | (uint32_t)clr.g << 8 | clr.b;
+
+    for (int py = y0; py < y1; py++) {
+        uint32_t *dst = pixels + (size_t)py * pixel_width;
+        for (int px = x0; px < x1; px++) dst[px] = solid;
+    }
+}
+
+/* ── Frame diffing ───────────────────────────────────────────── */
+
+static int floor_div(int a, int b) {
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+/* Widen pixel rows [*top, *bottom) to whole cells at a column offset */
+static void widen_to_cells(int *top, int *bottom, int offset) {
+    *top = floor_div(*top - offset, cell_h) * cell_h + offset;
+    *bottom = -floor_div(offset - *bottom, cell_h) * cell_h + offset;
+}
+
+/* Pixel rows [*top, *bottom) where a column differs between two grids.
+ * Returns 0 if it is the same in both. */
+static int column_diff(const cell_grid_t *was, const cell_grid_t *now, int col,
+                       int *top, int *bottom) {
+    const cell_t *a = was->cells + (size_t)col * grid_slots;
+    const cell_t *b = now->cells + (size_t)col * grid_slots;
+    int a_off = was->offset[col];
+    int b_off = now->offset[col];
+
+    if (a_off == b_off && memcmp(a, b, grid_slots * sizeof(cell_t)) == 0) return 0;
+
+    /* A moved stream differs wherever it was and wherever it is now */
+    int lo = INT_MAX, hi = INT_MIN;
+    for (int s = 0; s < grid_slots; s++) {
+        int y = (s - 1) * cell_h;
+        if (a_off == b_off) {
+            if (a[s] == b[s]) continue;
+            if (y + a_off < lo) lo = y + a_off;
+            if (y + a_off + cell_h > hi) hi = y + a_off + cell_h;
+            continue;
+        }
+        if (a[s]) {
+            if (y + a_off < lo) lo = y + a_off;
+            if (y + a_off + cell_h > hi) hi = y + a_off + cell_h;
+        }
+        if (b[s]) {
+            if (y + b_off < lo) lo = y + b_off;
+            if (y + b_off + cell_h > hi) hi = y + b_off + cell_h;
+        }
+    }
+    if (lo >= hi) return 0;
+
+    *top = lo;
+    *bottom = hi;
+    return 1;
+}
+
+/* Whether a grid's stats bar covers any of a column */
+static int stats_overlap(const cell_grid_t *g, int col) {
+    return g->stats_w > 0 && col * cell_w < g->stats_x + g->stats_w &&
+           (col + 1) * cell_w > g->stats_x;
+}
+
+/* Clear a rectangle of the buffer, clipped to the surface. Returns the
+ * pixels cleared. */
+static uint64_t clear_rect(uint32_t *pixels, int x, int y, int w, int h) {
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > pixel_width  ? pixel_width  : x + w;
+    int y1 = y + h > pixel_height ? pixel_height : y + h;
+    if (x0 >= x1 || y0 >= y1) return 0;
+
+    for (int py = y0; py < y1; py++) {
+        memset(pixels + (size_t)py * pixel_width + x0, 0, (size_t)(x1 - x0) * 4);
+    }
+    return (uint64_t)(x1 - x0) * (y1 - y0);
+}
+
+/* Clear pixel rows [top, bottom) of a column, which must be whole cells
+ * at its offset, and draw the grid's cells there. Returns the pixels
+ * cleared. */
+static uint64_t repaint_column(uint32_t *pixels, const cell_grid_t *g, int col,
+                           int top, int bottom) {
+    const cell_t *cells = g->cells + (size_t)col * grid_slots;
+    int offset = g->offset[col];
+    int x = col * cell_w;
+
+    uint64_t cleared = clear_rect(pixels, x, top, cell_w, bottom - top);
+
+    int first = (top - offset) / cell_h + 1;
+    int last = (bottom - offset) / cell_h + 1;
+    if (first < 0) first = 0;
+    if (last > grid_slots) last = grid_slots;
+
+    for (int s = first; s < last; s++) {
+        cell_t cell = cells[s];
+        if (!cell) continue;
+
+        int y = (s - 1) * cell_h + offset;
+        unsigned char glyph = cell & 0xff;
+        unsigned char color = cell >> 8;
+        if (glyph == CELL_HEAD) {
+            fill_cell(pixels, x, y, palette_head[color]);
+        } else {
+            blit_glyph(pixels, x, y, glyph, palette[color]);
+        }
+    }
+    return cleared;
+}
+
+/* ── Render workers ──────────────────────────────────────────── */
+
+/* With --render-threads N the columns are split into N bands of adjacent
+ * columns. The main thread repaints the first band and persistent workers
+ * the rest, and it waits for them all before the stats bar and commit.
+ * Columns never share pixels, so frames are identical for any N. */
+static pthread_t render_workers[RENDER_THREADS_MAX];
+static int render_worker_count = 0;
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t render_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t render_done = PTHREAD_COND_INITIALIZER;
+static unsigned long render_job = 0;   /* bumped for each frame */
+static int render_pending = 0;         /* worker bands not yet repainted */
+static int render_stopping = 0;
+
+/* The frame being repainted */
+static uint32_t *job_pixels;
+static const cell_grid_t *job_stale;
+static uint64_t band_pixels[RENDER_THREADS_MAX];
+
+static void repaint_band(int band) {
+    int bands = render_worker_count + 1;
+    int first = grid_cols * band / bands;
+    int last = grid_cols * (band + 1) / bands;
+    const cell_grid_t *stale = job_stale;
+    uint64_t pixels = 0;
+
+    for (int col = first; col < last; col++) {
+        int top, bottom;
+        int dirty = column_diff(stale, &frame_grid, col, &top, &bottom);
+
+        /* The stats bar this buffer was drawn with is already cleared:
+         * redraw the cells it covered */
+        if (stats_overlap(stale, col)) {
+            int stats_bottom = stale->stats_y + stale->stats_h;
+            if (!dirty || stale->stats_y < top) top = stale->stats_y;
+            if (!dirty || stats_bottom > bottom) bottom = stats_bottom;
+            dirty = 1;
+        }
+        if (!dirty) continue;
+
+        widen_to_cells(&top, &bottom, frame_grid.offset[col]);
+        pixels += repaint_column(job_pixels, &frame_grid, col, top, bottom);
+    }
+    band_pixels[band] = pixels;
+}
+
+static void *render_worker(void *arg) {
+    int band = (int)(intptr_t)arg;
+    unsigned long done_job = 0;
+
+    pthread_mutex_lock(&render_lock);
+    for (;;) {
+        while (!render_stopping && render_job == done_job) {
+            pthread_cond_wait(&render_go, &render_lock);
+        }
+        if (render_stopping) break;
+        done_job = render_job;
+        pthread_mutex_unlock(&render_lock);
+
+        repaint_band(band);
+
+        pthread_mutex_lock(&render_lock);
+        if (--render_pending == 0) pthread_cond_signal(&render_done);
+    }
+    pthread_mutex_unlock(&render_lock);
+    return NULL;
+}
+
+/* Repaint the columns where the buffer's grid differs from the frame's,
+ * over all bands */
+static void repaint_frame(uint32_t *pixels, const cell_grid_t *stale) {
+    job_pixels = pixels;
+    job_stale = stale;
+
+    if (render_worker_count > 0) {
+        pthread_mutex_lock(&render_lock);
+        render_pending = render_worker_count;
+        render_job++;
+        pthread_cond_broadcast(&render_go);
+        pthread_mutex_unlock(&render_lock);
+    }
+
+    repaint_band(0);
+
+    if (render_worker_count > 0) {
+        pthread_mutex_lock(&render_lock);
+        while (render_pending > 0) {
+            pthread_cond_wait(&render_done, &render_lock);
+        }
+        pthread_mutex_unlock(&render_lock);
+    }
+
+    for (int b = 0; b <= render_worker_count; b++) {
+        repainted_pixels += band_pixels[b];
+    }
+}
+
+static void start_render_workers(void) {
+    for (int b = 1; b < render_threads; b++) {
+        if (pthread_create(&render_workers[render_worker_count], NULL,
+                           render_worker, (void *)(intptr_t)b) != 0) {
+            perror("pthread_create");
+            render_threads = b;   /* repaint with the workers started */
+            break;
+        }
+        render_worker_count++;
+    }
+}
+
+static void stop_render_workers(void) {
+    pthread_mutex_lock(&render_lock);
+    render_stopping = 1;
+    pthread_cond_broadcast(&render_go);
+    pthread_mutex_unlock(&render_lock);
+
+    for (int i = 0; i < render_worker_count; i++) {
+        pthread_join(render_workers[i], NULL);
+    }
+    render_worker_count = 0;
+    render_stopping = 0;
+}
+
+/* ── Stats bar ───────────────────────────────────────────────── */
+
+#define STATS_MAX_LEN 256
+
+static void format_rate(char *buf, size_t size, unsigned long bps) {
+    if (bps < 1024) {
+        snprintf(buf, size, "%lu B/s", bps);
+    } else if (bps < 1024 * 1024) {
+        snprintf(buf, size, "%.1f KB/s", bps / 1024.0);
+    } else {
+        snprintf(buf, size, "%.1f MB/s", bps / (1024.0 * 1024.0));
+    }
+}
+
+/* Rate per interface, the sampling ratio and the packet count */
+static size_t format_capture_stats(char *stats, size_t size) {
+    size_t len = 0;
+    stats[0] = '\0';
+
+    /* One segment per interface, summing its fanout workers; names
+     * only matter with more than one interface */
+    int interfaces = capture_source_count / fanout_workers;
+    for (int i = 0; i < capture_source_count && len < size; i++) {
+        capture_source_t *src = capture_sources[i];
+        if (src->fanout_index != 0) continue;
+
+        unsigned long bytes_per_sec = 0;
+        unsigned int sampling = 1;
+        for (int w = i; w < i + fanout_workers && w < capture_source_count; w++) {
+            bytes_per_sec += capture_sources[w]->bytes_per_sec;
+            if (capture_sources[w]->sample_rate > sampling) {
+                sampling = capture_sources[w]->sample_rate;
+            }
+        }
+
+        char rate[32];
+        format_rate(rate, sizeof(rate), bytes_per_sec);
+
+        if (interfaces > 1) {
+            len += snprintf(stats + len, size - len, "%s%s %s",
+                            i > 0 ? " | " : "", src->name, rate);
+        } else {
+            len += snprintf(stats + len, size - len, "%s", rate);
+        }
+
+        /* Show the kernel sampling ratio while adaptive sampling is engaged */
+        if (sampling > 1 && len < size) {
+            len += snprintf(stats + len, size - len, " 1:%u", sampling);
+        }
+    }
+    if (len < size) {
+        len += snprintf(stats + len, size - len, " | %lu pkts",
+                        capture_total_packets());
+    }
+    return len;
+}
+
 /* ── Public API ──────────────────────────────────────────────── */
 
 int wayland_init(void) {
@@ -279,8 +959,11 @@ int wayland_init(void) {
         return -1;
     }
 
-    /* Measure font cell */
+    /* Measure font cell, then rasterize the characters at that size */
     measure_cell();
+    build_glyph_atlas();
+    create_stats_layout();
+    start_render_workers();
 
     /* Create surface */
     surface = wl_compositor_create_surface(compositor);
@@ -317,191 +1000,171 @@ int wayland_init(void) {
     return 0;
 }
 
-int render_frame_wayland(unsigned long frame_count) {
+int render_frame_wayland(void) {
     if (closed) return -1;
 
     shm_buffer_t *buf = get_free_buffer();
-    if (!buf) return 0;  /* skip frame */
 
-    /* Reset current-frame damage tracking */
-    memset(col_dmg_cur, 0, grid_cols * sizeof(col_damage_t));
-
-    int stride = pixel_width * 4;
-    cairo_surface_t *cs = cairo_image_surface_create_for_data(
-        buf->data, CAIRO_FORMAT_ARGB32, pixel_width, pixel_height, stride);
-    cairo_t *cr = cairo_create(cs);
+    /* Every simulated frame is drawn: wait for the compositor to let go
+     * of a buffer rather than skip one */
+    while (!buf && simulation) {
+        if (wl_display_dispatch(display) < 0 || closed) return -1;
+        buf = get_free_buffer();
+    }
+    if (!buf) {
+        counter_add(&frame_counters.frames_skipped, 1);
+        return 0;  /* skip frame */
+    }
+    counter_add(&frame_counters.frames_rendered, 1);
 
-    /* Clear to transparent black */
-    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-    cairo_set_source_rgba(cr, 0, 0, 0, 0);
-    cairo_paint(cr);
+    uint64_t render_start = profiling ? clock_us(CLOCK_MONOTONIC) : 0;
 
-    /* Switch to normal compositing for drawing */
-    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    /* Lay out this frame's cells */
+    memset(frame_grid.cells, 0, (size_t)grid_cols * grid_slots * sizeof(cell_t));
+    memset(frame_grid.offset, 0, (size_t)grid_cols * sizeof(int));
 
-    /* Set up Pango for character drawing */
-    PangoLayout *layout = pango_cairo_create_layout(cr);
-    PangoFontDescription *desc = pango_font_description_from_string(
-        FONT_FAMILY " " G_STRINGIFY(FONT_SIZE));
-    pango_layout_set_font_description(layout, desc);
+    /* Blink on the stream clock, so its rate doesn't follow the frame rate */
+    int head_lit = fmod(stream_clock, BLINK_CYCLE) < BLINK_ON;
 
-    char ch_buf[2] = {0, 0};
+    for (int i = 0; i < stream_count; i++) {
+        int col = streams.column[i];
+        if (col < 0 || col >= grid_cols) continue;
 
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        stream_t *s = &streams[i];
-        if (s->state == STREAM_EMPTY) continue;
-        if (s->column < 0 || s->column >= grid_cols) continue;
+        const stream_text_t *t = &stream_text[streams.id[i]];
+        const char *text = slab_ptr(t->text);
+        int chars_shown = (int)streams.chars_shown[i];
+        int text_len = streams.text_len[i];
 
-        int is_fading = (s->state == STREAM_FADING);
-        int col = s->column;
+        /* Fractional rows: the whole stream sits offset pixels below
+         * the cell rows */
+        int head_y = (int)lroundf(streams.row[i] * cell_h);
+        int offset = (head_y % cell_h + cell_h) % cell_h;
+        cell_t *cells = frame_grid.cells + (size_t)col * grid_slots;
+        frame_grid.offset[col] = offset;
 
-        for (int c = 0; c < s->chars_shown; c++) {
-            int row = (int)s->row - (s->chars_shown - 1 - c);
-            if (row < 0 || row >= grid_rows) continue;
+        for (int c = 0; c < chars_shown; c++) {
+            int y = head_y - (chars_shown - 1 - c) * cell_h;
+            if (y <= -cell_h || y >= grid_rows * cell_h) continue;
 
-            /* Track per-column damage */
-            if (!col_dmg_cur[col].active) {
-                col_dmg_cur[col].active  = 1;
-                col_dmg_cur[col].min_row = row;
-                col_dmg_cur[col].max_row = row;
-            } else {
-                if (row < col_dmg_cur[col].min_row) col_dmg_cur[col].min_row = row;
-                if (row > col_dmg_cur[col].max_row) col_dmg_cur[col].max_row = row;
-            }
+            int text_idx = text_len - chars_shown + c;
+            if (text_idx < 0 || text_idx >= text_len) continue;
 
-            int text_idx = s->text_len - s->chars_shown + c;
-            if (text_idx < 0 || text_idx >= s->text_len) continue;
-
-            double px_x = col * cell_w;
-            double px_y = row * cell_h;
-
-            if (is_fading) {
-                if (c == s->chars_shown - 1) {
-                    /* Blinking head block */
-                    if (frame_count % BLINK_CYCLE < BLINK_ON) {
-                        rgb_t clr = color_for_pair(s->colors[0]);
-                        /* Bright head */
-                        double r = clr.r * 1.3; if (r > 1.0) r = 1.0;
-                        double g = clr.g * 1.3; if (g > 1.0) g = 1.0;
-                        double b = clr.b * 1.3; if (b > 1.0) b = 1.0;
-                        cairo_set_source_rgba(cr, r, g, b, 1.0);
-                        cairo_rectangle(cr, px_x, px_y, cell_w, cell_h);
-                        cairo_fill(cr);
-                    }
-                    continue;
-                } else {
-                    /* Fading trail — dim */
-                    rgb_t clr = color_for_pair(s->colors[text_idx]);
-                    cairo_set_source_rgba(cr, clr.r, clr.g, clr.b, 1.0);
-                }
-            } else if (c == s->chars_shown - 1) {
-                /* Active head — blinking bright solid block */
-                if (frame_count % BLINK_CYCLE < BLINK_ON) {
-                    rgb_t clr = color_for_pair(s->colors[0]);
-                    double r = clr.r * 1.3; if (r > 1.0) r = 1.0;
-                    double g = clr.g * 1.3; if (g > 1.0) g = 1.0;
-                    double b = clr.b * 1.3; if (b > 1.0) b = 1.0;
-                    cairo_set_source_rgba(cr, r, g, b, 1.0);
-                    cairo_rectangle(cr, px_x, px_y, cell_w, cell_h);
-                    cairo_fill(cr);
+            int slot = (y - offset) / cell_h + 1;
+            if (c == chars_shown - 1) {
+                /* Head: blinking bright solid block, active or fading */
+                if (head_lit) {
+                    cells[slot] = (cell_t)(CELL_HEAD | color_at(&t->colors, 0) << 8);
                 }
                 continue;
-            } else {
-                /* Trail character */
-                rgb_t clr = color_for_pair(s->colors[text_idx]);
-                cairo_set_source_rgba(cr, clr.r, clr.g, clr.b, 1.0);
             }
 
-            /* Draw the character */
-            ch_buf[0] = s->text[text_idx];
-            cairo_move_to(cr, px_x, px_y);
-            pango_layout_set_text(layout, ch_buf, 1);
-            pango_cairo_show_layout(cr, layout);
+            /* Trail character */
+            cells[slot] = (cell_t)((unsigned char)text[text_idx] |
+                                   color_at(&t->colors, text_idx) << 8);
         }
     }
 
-    /* Draw stats bar in bottom-right */
-    char stats[64];
-    if (bytes_per_sec < 1024) {
-        snprintf(stats, sizeof(stats), "%lu B/s | %lu pkts",
-                 bytes_per_sec, packets_captured);
-    } else if (bytes_per_sec < 1024 * 1024) {
-        snprintf(stats, sizeof(stats), "%.1f KB/s | %lu pkts",
-                 bytes_per_sec / 1024.0, packets_captured);
+    /* Repaint what this buffer shows differently, starting with the
+     * stats bar it was last drawn with */
+    uint32_t *pixels = buf->data;
+    const cell_grid_t *stale = &buf->grid;
+    if (stale->stats_w > 0) {
+        repainted_pixels += clear_rect(pixels, stale->stats_x, stale->stats_y,
+                                       stale->stats_w, stale->stats_h);
+    }
+    repaint_frame(pixels, stale);
+    repainted_frames++;
+
+    /* Draw stats bar in bottom-right. A simulation shows its own clock:
+     * live rates and counts would differ between runs. */
+    char stats[STATS_MAX_LEN];
+    size_t len;
+    if (simulation) {
+        len = (size_t)snprintf(stats, sizeof(stats), "sim %.1fs", simulation_elapsed());
     } else {
-        snprintf(stats, sizeof(stats), "%.1f MB/s | %lu pkts",
-                 bytes_per_sec / (1024.0 * 1024.0), packets_captured);
+        len = format_capture_stats(stats, sizeof(stats));
+    }
+
+    /* Share of new streams admitted while traffic outruns the display */
+    if (admit_rate < 1.0 && len < sizeof(stats)) {
+        len += (size_t)snprintf(stats + len, sizeof(stats) - len, " | admit %.0f%%",
+                                admit_rate * 100);
     }
 
-    pango_layout_set_text(layout, stats, -1);
+    /* Packet-to-pixel latency since start */
+    if (latency_overlay && len < sizeof(stats)) {
+        char p50[16], p99[16];
+        latency_format(p50, sizeof(p50), latency_quantile(LATENCY_TOTAL, 0.5));
+        latency_format(p99, sizeof(p99), latency_quantile(LATENCY_TOTAL, 0.99));
+        snprintf(stats + len, sizeof(stats) - len, " | p50 %s p99 %s", p50, p99);
+    }
+
+    /* The stats bar is the one thing still drawn through Cairo and Pango,
+     * with a layout kept from startup */
+    cairo_surface_t *cs = cairo_image_surface_create_for_data(
+        buf->data, CAIRO_FORMAT_ARGB32, pixel_width, pixel_height, pixel_width * 4);
+    cairo_t *cr = cairo_create(cs);
+    pango_cairo_update_layout(cr, stats_layout);
+
+    pango_layout_set_text(stats_layout, stats, -1);
     PangoRectangle ink, logical;
-    pango_layout_get_pixel_extents(layout, &ink, &logical);
+    pango_layout_get_pixel_extents(stats_layout, &ink, &logical);
 
     double stats_x = pixel_width - logical.width - cell_w;
     double stats_y = pixel_height - cell_h;
     cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.7);
     cairo_move_to(cr, stats_x, stats_y);
-    pango_cairo_show_layout(cr, layout);
+    pango_cairo_show_layout(cr, stats_layout);
 
-    /* Current stats bar region */
-    int cur_stats_x = (int)stats_x;
-    int cur_stats_y = (int)stats_y;
-    int cur_stats_w = logical.width + cell_w;
-    int cur_stats_h = cell_h;
+    frame_grid.stats_x = (int)stats_x;
+    frame_grid.stats_y = (int)stats_y;
+    frame_grid.stats_w = logical.width + cell_w;
+    frame_grid.stats_h = cell_h;
 
-    pango_font_description_free(desc);
-    g_object_unref(layout);
     cairo_destroy(cr);
     cairo_surface_destroy(cs);
 
+    if (profiling) {
+        latency_histogram_add(&render_times, clock_us(CLOCK_MONOTONIC) - render_start);
+    }
+
     /* Attach buffer */
     wl_surface_attach(surface, buf->wl_buf, 0, 0);
 
-    /* Damage only changed columns (union of prev and cur active regions) */
-    for (int c = 0; c < grid_cols; c++) {
-        if (!col_dmg_cur[c].active && !col_dmg_prev[c].active)
-            continue;
-
-        int r_min, r_max;
-        if (col_dmg_cur[c].active && col_dmg_prev[c].active) {
-            r_min = col_dmg_cur[c].min_row < col_dmg_prev[c].min_row
-                  ? col_dmg_cur[c].min_row : col_dmg_prev[c].min_row;
-            r_max = col_dmg_cur[c].max_row > col_dmg_prev[c].max_row
-                  ? col_dmg_cur[c].max_row : col_dmg_prev[c].max_row;
-        } else if (col_dmg_cur[c].active) {
-            r_min = col_dmg_cur[c].min_row;
-            r_max = col_dmg_cur[c].max_row;
-        } else {
-            r_min = col_dmg_prev[c].min_row;
-            r_max = col_dmg_prev[c].max_row;
+    /* Damage what changed since the last commit: the columns that differ
+     * and both stats bars. The first frame after a resize damages all. */
+    if (!shown_buf) {
+        wl_surface_damage_buffer(surface, 0, 0, INT32_MAX, INT32_MAX);
+    } else {
+        const cell_grid_t *shown = &shown_buf->grid;
+        for (int col = 0; col < grid_cols; col++) {
+            int top, bottom;
+            if (!column_diff(shown, &frame_grid, col, &top, &bottom)) continue;
+
+            if (top < 0) top = 0;
+            if (bottom > pixel_height) bottom = pixel_height;
+            wl_surface_damage_buffer(surface, col * cell_w, top, cell_w, bottom - top);
         }
 
-        int px_x = c * cell_w;
-        int px_y = r_min * cell_h;
-        int px_h = (r_max - r_min + 1) * cell_h;
-        wl_surface_damage_buffer(surface, px_x, px_y, cell_w, px_h);
-    }
-
-    /* Damage stats bar (union of prev and cur position) */
-    wl_surface_damage_buffer(surface, cur_stats_x, cur_stats_y,
-                             cur_stats_w, cur_stats_h);
-    if (stats_prev_w > 0) {
-        wl_surface_damage_buffer(surface, stats_prev_x, stats_prev_y,
-                                 stats_prev_w, stats_prev_h);
+        if (shown->stats_w > 0) {
+            wl_surface_damage_buffer(surface, shown->stats_x, shown->stats_y,
+                                     shown->stats_w, shown->stats_h);
+        }
     }
+    wl_surface_damage_buffer(surface, frame_grid.stats_x, frame_grid.stats_y,
+                             frame_grid.stats_w, frame_grid.stats_h);
 
+    request_frame_events();
     wl_surface_commit(surface);
     buf->busy = 1;
+    streams_presented();
 
-    /* Save damage state for next frame */
-    col_damage_t *tmp = col_dmg_prev;
-    col_dmg_prev = col_dmg_cur;
-    col_dmg_cur  = tmp;
-
-    stats_prev_x = cur_stats_x;
-    stats_prev_y = cur_stats_y;
-    stats_prev_w = cur_stats_w;
-    stats_prev_h = cur_stats_h;
+    /* The buffer now shows this frame's grid, and its old grid takes the
+     * next frame */
+    cell_grid_t tmp = buf->grid;
+    buf->grid = frame_grid;
+    frame_grid = tmp;
+    shown_buf = buf;
 
     return wl_display_flush(display) < 0 ? -1 : 0;
 }
@@ -530,6 +1193,58 @@ int wayland_dispatch(void) {
     return 0;
 }
 
+int wayland_frame_ready(void) {
+    return !frame_callback && get_free_buffer() != NULL;
+}
+
+long wayland_frame_interval(long target_us) {
+    long refresh_us = (long)(refresh_ns / 1000);
+    pace_interval_us = target_us > refresh_us ? target_us : refresh_us;
+    return pace_interval_us;
+}
+
+static void print_pacing(FILE *f, const char *label, latency_histogram_t *h) {
+    if (h->count == 0) return;
+
+    char p50[16], p99[16];
+    latency_format(p50, sizeof(p50), latency_histogram_quantile(h, 0.5));
+    latency_format(p99, sizeof(p99), latency_histogram_quantile(h, 0.99));
+    fprintf(f, "  %-9s %10lu samples  p50 %7s  p99 %7s\n",
+            label, (unsigned long)h->count, p50, p99);
+}
+
+void wayland_print_summary(FILE *f) {
+    if (!presentation_supported) {
+        fprintf(f, "Presentation: not supported by the compositor, paced by frame callbacks\n");
+        return;
+    }
+
+    fprintf(f, "Presentation: %lu frames presented, %lu discarded",
+            (unsigned long)frame_counters.frames_presented,
+            (unsigned long)frame_counters.frames_discarded);
+    if (refresh_ns) fprintf(f, ", output at %.2f Hz", 1e9 / refresh_ns);
+    fputc('\n', f);
+
+    print_pacing(f, "latency", &present_latency);
+    print_pacing(f, "interval", &present_interval);
+    print_pacing(f, "jitter", &present_jitter);
+}
+
+void wayland_print_profile(void) {
+    if (render_times.count == 0) return;
+
+    char p50[16], p99[16];
+    latency_format(p50, sizeof(p50), latency_histogram_quantile(&render_times, 0.5));
+    latency_format(p99, sizeof(p99), latency_histogram_quantile(&render_times, 0.99));
+    printf("render: p50 %s p99 %s per frame at %dx%d (%dx%d cells), %d thread%s\n",
+           p50, p99, pixel_width, pixel_height, grid_cols, grid_rows,
+           render_threads, render_threads > 1 ? "s" : "");
+    if (repainted_frames && pixel_width && pixel_height) {
+        printf("repaint: %.1f%% of pixels per frame\n",
+               100.0 * repainted_pixels / repainted_frames / pixel_width / pixel_height);
+    }
+}
+
 int wayland_get_fd(void) {
     return wl_display_get_fd(display);
 }
@@ -551,14 +1266,42 @@ int wayland_check_reconfigure(void) {
 }
 
 void wayland_cleanup(void) {
-    free(col_dmg_prev);
-    free(col_dmg_cur);
-    col_dmg_prev = NULL;
-    col_dmg_cur  = NULL;
+    stop_render_workers();
+
+    free_grid(&frame_grid);
+    free_grid(&buffers[0].grid);
+    free_grid(&buffers[1].grid);
+    shown_buf = NULL;
+
+    free(atlas);
+    atlas = NULL;
+    if (stats_layout) {
+        g_object_unref(stats_layout);
+        stats_layout = NULL;
+    }
+    if (stats_font) {
+        pango_font_description_free(stats_font);
+        stats_font = NULL;
+    }
 
     destroy_buffer(&buffers[0]);
     destroy_buffer(&buffers[1]);
 
+    if (frame_callback) {
+        wl_callback_destroy(frame_callback);
+        frame_callback = NULL;
+    }
+    for (int i = 0; i < PRESENT_FEEDBACK_SLOTS; i++) {
+        if (present_slots[i].feedback) {
+            wp_presentation_feedback_destroy(present_slots[i].feedback);
+            present_slots[i].feedback = NULL;
+        }
+    }
+    if (presentation) {
+        wp_presentation_destroy(presentation);
+        presentation = NULL;
+    }
+
     if (layer_surface) {
         zwlr_layer_surface_v1_destroy(layer_surface);
         layer_surface = NULL;
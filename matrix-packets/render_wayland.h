@@ -1,8 +1,16 @@
 #ifndef RENDER_WAYLAND_H
 #define RENDER_WAYLAND_H
 
+#include <stdio.h>
+
 #include "streams.h"
 
+/* Configuration */
+#define RENDER_THREADS_MAX 64   /* highest --render-threads */
+
+/* Globals (defined in render_wayland.c) */
+extern int render_threads;   /* threads repainting each frame, 1 by default */
+
 /* Initialize Wayland connection, layer-shell surface, and Cairo context.
  * Blocks until the first configure event provides pixel dimensions.
  * Sets cell_width/cell_height and computes screen_width_cells/screen_height_cells.
@@ -11,7 +19,24 @@ int wayland_init(void);
 
 /* Render one frame: clear buffer, draw streams, draw stats bar, commit.
  * Returns 0 on success, -1 if the display connection is lost. */
-int render_frame_wayland(unsigned long frame_count);
+int render_frame_wayland(void);
+
+/* 1 when the compositor wants a new frame: the last commit's frame
+ * callback has fired and a buffer is free. Hidden outputs send no
+ * callbacks, so nothing is drawn for them. */
+int wayland_frame_ready(void);
+
+/* Frame interval to pace at: target_us, but no shorter than the output's
+ * refresh period. Also the reference presentation jitter is measured
+ * against. */
+long wayland_frame_interval(long target_us);
+
+/* Frames presented and discarded, with commit-to-present latency,
+ * present interval and jitter (needs wp_presentation) */
+void wayland_print_summary(FILE *f);
+
+/* Time to draw a frame into its buffer, with --profile */
+void wayland_print_profile(void);
 
 /* Dispatch pending Wayland events (non-blocking).
  * Returns the Wayland display fd for use with poll(). */
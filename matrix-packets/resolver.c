@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include "resolver.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+_Static_assert(RESOLVER_CACHE_SIZE % RESOLVER_CACHE_WAYS == 0,
+               "RESOLVER_CACHE_SIZE must be a multiple of RESOLVER_CACHE_WAYS");
+
+#define RESOLVER_SETS (RESOLVER_CACHE_SIZE / RESOLVER_CACHE_WAYS)
+
+/* Globals */
+int resolve_names = 0;
+
+typedef struct {
+    int family;              /* 0 marks an unused entry */
+    uint8_t addr[16];
+    int state;               /* RESOLVE_* */
+    time_t expires;          /* CLOCK_MONOTONIC seconds */
+    char name[RESOLVER_NAME_LEN];
+} resolver_entry_t;
+
+typedef struct {
+    int family;
+    uint8_t addr[16];
+} resolver_request_t;
+
+/* Cache, queue and counters share one lock. The frame loop only ever
+ * trylocks it; the workers hold it briefly and never across a lookup. */
+static pthread_mutex_t resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolver_wake = PTHREAD_COND_INITIALIZER;
+static resolver_entry_t cache[RESOLVER_SETS][RESOLVER_CACHE_WAYS];
+static resolver_request_t queue[RESOLVER_QUEUE_SIZE];
+static unsigned int queue_head = 0, queue_len = 0;
+static int resolver_running = 0;
+
+/* Counters */
+static unsigned long lookups, hits, negative_hits, queue_full;
+static atomic_ulong busy_misses;   /* counted without the lock */
+static atomic_uint answers;        /* resolver_generation() */
+static unsigned long resolved, failed;
+static double latency_total_ms, latency_max_ms;
+
+static time_t now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+static size_t addr_len(int family) {
+    return family == AF_INET6 ? 16 : 4;
+}
+
+static unsigned int addr_set(int family, const uint8_t *addr) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < addr_len(family); i++) {
+        h ^= addr[i];
+        h *= 16777619u;
+    }
+    return h % RESOLVER_SETS;
+}
+
+static resolver_entry_t *cache_find(int family, const uint8_t *addr) {
+    resolver_entry_t *set = cache[addr_set(family, addr)];
+    for (int w = 0; w < RESOLVER_CACHE_WAYS; w++) {
+        if (set[w].family == family &&
+            memcmp(set[w].addr, addr, addr_len(family)) == 0) {
+            return &set[w];
+        }
+    }
+    return NULL;
+}
+
+/* Reuse an empty way if there is one, else the one expiring first */
+static resolver_entry_t *cache_claim(int family, const uint8_t *addr) {
+    resolver_entry_t *set = cache[addr_set(family, addr)];
+    resolver_entry_t *victim = &set[0];
+    for (int w = 0; w < RESOLVER_CACHE_WAYS; w++) {
+        if (set[w].family == 0) {
+            victim = &set[w];
+            break;
+        }
+        if (set[w].expires < victim->expires) victim = &set[w];
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->family = family;
+    memcpy(victim->addr, addr, addr_len(family));
+    return victim;
+}
+
+int resolver_lookup(int family, const uint8_t *addr, char *name, size_t size) {
+    if (pthread_mutex_trylock(&resolver_lock) != 0) {
+        atomic_fetch_add_explicit(&busy_misses, 1, memory_order_relaxed);
+        return RESOLVE_PENDING;
+    }
+
+    /* A lookup is counted when the cache answers it or it is queued; an
+     * address asked about again while pending is neither */
+    time_t now = now_sec();
+    int state = RESOLVE_PENDING;
+    resolver_entry_t *e = cache_find(family, addr);
+
+    if (e && e->expires > now) {
+        state = e->state;
+        if (state == RESOLVE_OK) {
+            snprintf(name, size, "%s", e->name);
+            lookups++;
+            hits++;
+        } else if (state == RESOLVE_FAILED) {
+            lookups++;
+            negative_hits++;
+        }
+    } else if (!resolver_running) {
+        /* Nothing would answer; leave the address as it is */
+    } else if (queue_len == RESOLVER_QUEUE_SIZE) {
+        queue_full++;
+    } else {
+        e = e ? e : cache_claim(family, addr);
+        e->state = RESOLVE_PENDING;
+        e->expires = now + RESOLVER_PENDING_TTL_SEC;
+        lookups++;
+
+        resolver_request_t *req = &queue[(queue_head + queue_len++) % RESOLVER_QUEUE_SIZE];
+        req->family = family;
+        memcpy(req->addr, addr, addr_len(family));
+        pthread_cond_signal(&resolver_wake);
+    }
+
+    pthread_mutex_unlock(&resolver_lock);
+    return state;
+}
+
+/* Reverse lookup through the system resolver, so /etc/hosts and
+ * nsswitch apply. libc does not expose record TTLs, so results live
+ * for the fixed positive and negative TTLs. */
+static int reverse_lookup(const resolver_request_t *req, char *name, size_t size) {
+    struct sockaddr_storage ss;
+    socklen_t len;
+    memset(&ss, 0, sizeof(ss));
+
+    if (req->family == AF_INET6) {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+        sin6->sin6_family = AF_INET6;
+        memcpy(&sin6->sin6_addr, req->addr, 16);
+        len = sizeof(*sin6);
+    } else {
+        struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+        sin->sin_family = AF_INET;
+        memcpy(&sin->sin_addr, req->addr, 4);
+        len = sizeof(*sin);
+    }
+
+    return getnameinfo((struct sockaddr *)&ss, len, name, size, NULL, 0, NI_NAMEREQD);
+}
+
+static void *resolver_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&resolver_lock);
+    while (resolver_running) {
+        if (queue_len == 0) {
+            pthread_cond_wait(&resolver_wake, &resolver_lock);
+            continue;
+        }
+
+        resolver_request_t req = queue[queue_head];
+        queue_head = (queue_head + 1) % RESOLVER_QUEUE_SIZE;
+        queue_len--;
+        pthread_mutex_unlock(&resolver_lock);
+
+        char host[NI_MAXHOST];
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int rc = reverse_lookup(&req, host, sizeof(host));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+        pthread_mutex_lock(&resolver_lock);
+        latency_total_ms += ms;
+        if (ms > latency_max_ms) latency_max_ms = ms;
+
+        /* The entry may have been evicted while we waited */
+        resolver_entry_t *e = cache_find(req.family, req.addr);
+        if (!e) e = cache_claim(req.family, req.addr);
+        if (rc == 0) {
+            e->state = RESOLVE_OK;
+            e->expires = now_sec() + RESOLVER_POSITIVE_TTL_SEC;
+            /* Long names are cut to fit; the column could not show them anyway */
+            size_t n = strnlen(host, sizeof(e->name) - 1);
+            memcpy(e->name, host, n);
+            e->name[n] = '\0';
+            resolved++;
+        } else {
+            e->state = RESOLVE_FAILED;
+            e->expires = now_sec() + RESOLVER_NEGATIVE_TTL_SEC;
+            failed++;
+        }
+        atomic_fetch_add_explicit(&answers, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&resolver_lock);
+    return NULL;
+}
+
+int resolver_start(void) {
+    resolver_running = 1;
+    for (int i = 0; i < RESOLVER_WORKERS; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, resolver_thread, NULL) != 0) {
+            perror("pthread_create");
+            resolver_stop();
+            return -1;
+        }
+        pthread_detach(thread);
+    }
+    return 0;
+}
+
+void resolver_stop(void) {
+    pthread_mutex_lock(&resolver_lock);
+    resolver_running = 0;
+    pthread_cond_broadcast(&resolver_wake);
+    pthread_mutex_unlock(&resolver_lock);
+}
+
+unsigned int resolver_generation(void) {
+    return atomic_load_explicit(&answers, memory_order_acquire);
+}
+
+void resolver_print_summary(void) {
+    pthread_mutex_lock(&resolver_lock);
+    unsigned long answered = resolved + failed;
+    printf("Resolver: %lu lookups, %.1f%% answered from cache "
+           "(%lu names, %lu negative), %lu skipped while busy, %lu queue full\n",
+           lookups, lookups ? 100.0 * (hits + negative_hits) / lookups : 0.0,
+           hits, negative_hits, (unsigned long)busy_misses, queue_full);
+    if (answered > 0) {
+        printf("Resolver: %lu resolved, %lu without a name, "
+               "%.1f ms average latency, %.1f ms worst\n",
+               resolved, failed, latency_total_ms / answered, latency_max_ms);
+    }
+    pthread_mutex_unlock(&resolver_lock);
+}
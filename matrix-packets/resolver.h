@@ -0,0 +1,44 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Configuration */
+#define RESOLVER_CACHE_SIZE        1024  /* entries, a multiple of the ways */
+#define RESOLVER_CACHE_WAYS        4     /* entries per hash set */
+#define RESOLVER_QUEUE_SIZE        256   /* addresses waiting for a worker */
+#define RESOLVER_WORKERS           2
+#define RESOLVER_POSITIVE_TTL_SEC  300
+#define RESOLVER_NEGATIVE_TTL_SEC  60
+#define RESOLVER_PENDING_TTL_SEC   30    /* retry a lookup that never finished */
+#define RESOLVER_NAME_LEN          64
+
+/* Lookup results */
+#define RESOLVE_PENDING  0   /* not known yet; show the address */
+#define RESOLVE_OK       1   /* name copied out */
+#define RESOLVE_FAILED   2   /* address has no name (cached negative) */
+
+/* Set by --names (defined in resolver.c) */
+extern int resolve_names;
+
+/* Start the resolver workers. Returns 0 on success. */
+int resolver_start(void);
+
+/* Ask the workers to stop. Lookups in flight are abandoned, not joined,
+ * so a slow DNS server cannot hold up shutdown. */
+void resolver_stop(void);
+
+/* Look an address up in the cache without ever blocking: if the cache
+ * is busy or the address is unknown it returns RESOLVE_PENDING, queueing
+ * the address for the workers when it can. */
+int resolver_lookup(int family, const uint8_t *addr, char *name, size_t size);
+
+/* Bumped whenever a worker finishes a lookup: until it changes, a
+ * PENDING answer would come back PENDING again. Never blocks. */
+unsigned int resolver_generation(void);
+
+/* Print cache hit rate and resolver latency */
+void resolver_print_summary(void);
+
+#endif /* RESOLVER_H */
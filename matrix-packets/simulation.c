@@ -0,0 +1,32 @@
+#include "simulation.h"
+
+#include <time.h>
+
+/* Globals */
+int simulation = 0;   /* --seed with --read: frames advance on replay time */
+
+/* Frame loop only */
+static uint64_t clock_start_us = 0;
+static uint64_t clock_now_us = 0;
+
+void simulation_start(uint64_t start_us) {
+    clock_start_us = start_us;
+    clock_now_us = start_us;
+}
+
+void simulation_advance(uint64_t step_us) {
+    clock_now_us += step_us;
+}
+
+uint64_t simulation_now_us(void) {
+    return clock_now_us;
+}
+
+double simulation_elapsed(void) {
+    return (clock_now_us - clock_start_us) / 1e6;
+}
+
+void simulation_pause(void) {
+    struct timespec step = { 0, SIMULATION_POLL_US * 1000L };
+    nanosleep(&step, NULL);
+}
@@ -0,0 +1,27 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdint.h>
+
+/* Configuration */
+#define SIMULATION_POLL_US  100   /* replay/frame loop hand-off polling */
+
+/* Globals (defined in simulation.c) */
+extern int simulation;
+
+/* Start the frame clock at a replay timestamp */
+void simulation_start(uint64_t start_us);
+
+/* Advance the frame clock by one frame */
+void simulation_advance(uint64_t step_us);
+
+/* Frame clock: microseconds on the replay's own timeline */
+uint64_t simulation_now_us(void);
+
+/* Seconds of replay time simulated so far */
+double simulation_elapsed(void);
+
+/* Sleep SIMULATION_POLL_US while waiting on the other side */
+void simulation_pause(void);
+
+#endif /* SIMULATION_H */
@@ -0,0 +1,108 @@
+#include "slab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HANDLE_CLASS_SHIFT 28
+#define HANDLE_INDEX_MASK  ((1u << HANDLE_CLASS_SHIFT) - 1)
+
+/* One size class: fixed-size chunks in equally sized pages. Free chunks
+ * form a list threaded through their first bytes. Only the frame loop
+ * allocates and frees, so there is no locking. */
+typedef struct {
+    char **pages;
+    int page_count;
+    int page_slots;
+    uint32_t chunk_count;      /* chunks carved so far */
+    uint32_t free_head;        /* chunk number + 1, 0 when empty */
+    uint32_t in_use;
+} slab_class_t;
+
+static slab_class_t classes[SLAB_CLASSES];
+
+static inline size_t chunk_size(int cls) {
+    return (size_t)1 << (SLAB_MIN_SHIFT + cls);
+}
+
+static inline uint32_t chunks_per_page(int cls) {
+    return SLAB_PAGE_SIZE >> (SLAB_MIN_SHIFT + cls);
+}
+
+static char *chunk_addr(int cls, uint32_t index) {
+    slab_class_t *c = &classes[cls];
+    uint32_t per_page = chunks_per_page(cls);
+    return c->pages[index / per_page] + (size_t)(index % per_page) * chunk_size(cls);
+}
+
+static void *slab_xalloc(void *old, size_t size) {
+    void *p = realloc(old, size);
+    if (!p) {
+        fprintf(stderr, "Failed to allocate stream text\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* Carve a new chunk, adding a page when the last one is used up */
+static uint32_t grow_class(int cls) {
+    slab_class_t *c = &classes[cls];
+
+    if (c->chunk_count == (uint32_t)c->page_count * chunks_per_page(cls)) {
+        if (c->page_count == c->page_slots) {
+            c->page_slots = c->page_slots ? c->page_slots * 2 : 4;
+            c->pages = slab_xalloc(c->pages, c->page_slots * sizeof(char *));
+        }
+        c->pages[c->page_count++] = slab_xalloc(NULL, SLAB_PAGE_SIZE);
+    }
+    return c->chunk_count++;
+}
+
+slab_handle_t slab_alloc(size_t size) {
+    int cls = 0;
+    while (cls < SLAB_CLASSES - 1 && chunk_size(cls) < size) cls++;
+
+    slab_class_t *c = &classes[cls];
+    uint32_t index;
+    if (c->free_head) {
+        index = c->free_head - 1;
+        memcpy(&c->free_head, chunk_addr(cls, index), sizeof(uint32_t));
+    } else {
+        index = grow_class(cls);
+    }
+
+    c->in_use++;
+    return ((uint32_t)cls << HANDLE_CLASS_SHIFT) | (index + 1);
+}
+
+void slab_free(slab_handle_t h) {
+    if (!h) return;
+
+    int cls = (int)(h >> HANDLE_CLASS_SHIFT);
+    uint32_t index = (h & HANDLE_INDEX_MASK) - 1;
+    slab_class_t *c = &classes[cls];
+
+    memcpy(chunk_addr(cls, index), &c->free_head, sizeof(uint32_t));
+    c->free_head = index + 1;
+    c->in_use--;
+}
+
+char *slab_ptr(slab_handle_t h) {
+    return chunk_addr((int)(h >> HANDLE_CLASS_SHIFT), (h & HANDLE_INDEX_MASK) - 1);
+}
+
+size_t slab_bytes_used(void) {
+    size_t total = 0;
+    for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+        total += classes[cls].in_use * chunk_size(cls);
+    }
+    return total;
+}
+
+size_t slab_bytes_reserved(void) {
+    size_t total = 0;
+    for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+        total += (size_t)classes[cls].page_count * SLAB_PAGE_SIZE;
+    }
+    return total;
+}
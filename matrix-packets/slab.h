@@ -0,0 +1,33 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Configuration */
+#define SLAB_MIN_SHIFT   6       /* smallest chunk: 64 bytes */
+#define SLAB_CLASSES     3       /* 64, 128 and 256-byte chunks */
+#define SLAB_PAGE_SIZE   16384   /* chunks are carved from pages this size */
+
+#define SLAB_MAX_CHUNK   (1 << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1))
+
+/* Chunk reference: size class in the top bits, chunk number below.
+ * 0 is never handed out, so zeroed structures hold no chunk. */
+typedef uint32_t slab_handle_t;
+
+/* Chunk of the smallest class that holds size bytes (at most
+ * SLAB_MAX_CHUNK). Exits if memory runs out, like the other
+ * frame-loop allocations. */
+slab_handle_t slab_alloc(size_t size);
+
+/* Return a chunk to its class's free list (0 is ignored) */
+void slab_free(slab_handle_t h);
+
+/* Address of a chunk; valid until it is freed */
+char *slab_ptr(slab_handle_t h);
+
+/* Bytes of chunks handed out and of pages allocated */
+size_t slab_bytes_used(void);
+size_t slab_bytes_reserved(void);
+
+#endif /* SLAB_H */
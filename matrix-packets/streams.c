@@ -1,174 +1,440 @@
 #include "streams.h"
+#include "admit.h"
+#include "flows.h"
+#include "columns.h"
+#include "profile.h"
+#include "metrics.h"
+#include "latency.h"
+#include "simulation.h"
+#include "resolver.h"
+#include "prng.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 /* Globals */
-stream_t streams[MAX_STREAMS];
+stream_table_t streams;
+stream_text_t *stream_text = NULL;
+int stream_count = 0;
+int stream_capacity = 0;
 int stream_screen_width = 0;
 int stream_screen_height = 0;
+double stream_clock = 0;
 
 /* Private state */
-static int *column_available = NULL;
-static int free_slots[MAX_STREAMS];
-static int free_slot_count = 0;
+static int *stream_pos = NULL;        /* id -> position, -1 while free */
+static int *free_ids = NULL;
+static int free_id_count = 0;
+static unsigned int next_generation = 1;
+static double last_update = 0;   /* stream_clock of the previous update */
+static float spawn_credit = 0;   /* streams admissible, STREAMS_PER_SECOND */
+static prng_t stream_rng;
 
-/* Check if a column is free with sufficient gap from neighbors */
-static int column_is_spaced(int col) {
-    if (!column_available[col]) return 0;
-    for (int g = 1; g <= COLUMN_GAP; g++) {
-        if (col - g >= 0 && !column_available[col - g]) return 0;
-        if (col + g < stream_screen_width && !column_available[col + g]) return 0;
+/* Records behind metadata streams still waiting on a hostname, by id */
+static packet_record_t *pending_records = NULL;
+
+/* Formatter cost when profiling */
+static uint64_t format_ticks = 0;
+static unsigned long format_calls = 0;
+
+/* Per-frame drain state handed to assign_record_to_streams() */
+typedef struct {
+    double now;
+    uint64_t now_us;   /* wall clock, for the latency histograms */
+    int screen_height;
+} frame_ctx_t;
+
+static void *stream_calloc(size_t n, size_t size) {
+    void *p = calloc(n ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Failed to allocate streams\n");
+        exit(1);
     }
-    return 1;
+    return p;
 }
 
-/* Find a free column */
-static int find_free_column(int zone) {
-    (void)zone;
-    if (stream_screen_width < 3) return -1;
+/* Every live stream owns a column and keeps COLUMN_GAP free either side,
+ * so the screen width bounds how many can exist at once */
+static void alloc_streams(int width) {
+    for (int i = 0; i < stream_count; i++) {
+        slab_free(stream_text[streams.id[i]].text);
+    }
+    stream_capacity = (width + COLUMN_GAP) / (COLUMN_GAP + 1);
+    stream_count = 0;
 
-    for (int attempt = 0; attempt < COLUMN_SEARCH_ATTEMPTS; attempt++) {
-        int col = rand() % stream_screen_width;
-        if (column_is_spaced(col)) {
-            return col;
-        }
+    free(streams.id);
+    free(streams.state);
+    free(streams.column);
+    free(streams.row);
+    free(streams.speed);
+    free(streams.text_len);
+    free(streams.chars_shown);
+    free(streams.age);
+    free(streams.fade_at);
+    free(stream_text);
+    free(stream_pos);
+    free(free_ids);
+    free(pending_records);
+
+    streams.id            = stream_calloc(stream_capacity, sizeof(int));
+    streams.state         = stream_calloc(stream_capacity, sizeof(int));
+    streams.column        = stream_calloc(stream_capacity, sizeof(int));
+    streams.row           = stream_calloc(stream_capacity, sizeof(float));
+    streams.speed         = stream_calloc(stream_capacity, sizeof(float));
+    streams.text_len      = stream_calloc(stream_capacity, sizeof(int));
+    streams.chars_shown   = stream_calloc(stream_capacity, sizeof(float));
+    streams.age           = stream_calloc(stream_capacity, sizeof(float));
+    streams.fade_at       = stream_calloc(stream_capacity, sizeof(float));
+    stream_text     = stream_calloc(stream_capacity, sizeof(stream_text_t));
+    stream_pos      = stream_calloc(stream_capacity, sizeof(int));
+    free_ids        = stream_calloc(stream_capacity, sizeof(int));
+    pending_records = stream_calloc(stream_capacity, sizeof(packet_record_t));
+
+    free_id_count = stream_capacity;
+    for (int i = 0; i < stream_capacity; i++) {
+        stream_pos[i] = -1;
+        free_ids[i] = stream_capacity - 1 - i;
     }
 
-    for (int i = 0; i < stream_screen_width; i++) {
-        if (column_is_spaced(i)) {
-            return i;
-        }
+    columns_init(width);
+}
+
+/* Claim a free id and column for a new stream in the given zone and
+ * append it. Returns its position; the caller fills in the text. */
+static int spawn_stream(int zone) {
+    if (free_id_count == 0) {
+        counter_add(&frame_counters.streams_no_slot, 1);
+        return -1;
+    }
+
+    int col = column_claim(zone);
+    if (col < 0) {
+        counter_add(&frame_counters.streams_no_column, 1);
+        return -1;
     }
 
-    return -1;
+    int id = free_ids[--free_id_count];
+    int pos = stream_count++;
+    stream_pos[id] = pos;
+
+    streams.id[pos] = id;
+    streams.state[pos] = STREAM_ACTIVE;
+    streams.column[pos] = col;
+    streams.row[pos] = 0;
+    streams.speed[pos] = STREAM_SPEED_MIN
+                       + prng_below(&stream_rng, (uint32_t)(STREAM_SPEED_RANGE * 100)) / 100.0f;
+    streams.text_len[pos] = 0;
+    streams.chars_shown[pos] = 0;
+    streams.age[pos] = 0;
+    streams.fade_at[pos] = FADE_DELAY_MIN
+                         + prng_below(&stream_rng, (uint32_t)(FADE_DELAY_RANGE * 100)) / 100.0f;
+
+    stream_text_t *t = &stream_text[id];
+    t->text = 0;
+    t->generation = next_generation++;
+    t->names_pending = 0;
+    t->shown = 0;
+
+    counter_add(&frame_counters.streams_spawned, 1);
+    return pos;
 }
 
-/* Assign a packet to a new stream */
-static void assign_packet_to_stream(packet_t *pkt) {
-    if (free_slot_count == 0) return;
+/* Free a stream's id and column, moving the last stream into its place */
+static void remove_stream(int pos) {
+    int id = streams.id[pos];
+    column_release(streams.column[pos]);
+    slab_free(stream_text[id].text);
+    stream_text[id].text = 0;
+    stream_pos[id] = -1;
+    free_ids[free_id_count++] = id;
+
+    int last = --stream_count;
+    if (pos == last) return;
 
-    int col = find_free_column(pkt->column_zone);
-    if (col < 0) return;
+    streams.id[pos]            = streams.id[last];
+    streams.state[pos]         = streams.state[last];
+    streams.column[pos]        = streams.column[last];
+    streams.row[pos]           = streams.row[last];
+    streams.speed[pos]         = streams.speed[last];
+    streams.text_len[pos]      = streams.text_len[last];
+    streams.chars_shown[pos]   = streams.chars_shown[last];
+    streams.age[pos]           = streams.age[last];
+    streams.fade_at[pos]       = streams.fade_at[last];
+    stream_pos[streams.id[pos]] = pos;
+}
 
-    int idx = free_slots[--free_slot_count];
-    stream_t *s = &streams[idx];
+/* Position of the stream a flow points at, or -1 if it no longer shows
+ * that flow */
+static int flow_stream(int id, unsigned int generation) {
+    if (id < 0 || id >= stream_capacity) return -1;
+    if (stream_pos[id] < 0 || stream_text[id].generation != generation) return -1;
+    return stream_pos[id];
+}
 
-    s->state = STREAM_ACTIVE;
-    s->column = col;
-    s->row = 0;
-    s->speed = STREAM_SPEED_MIN + (rand() % (int)(STREAM_SPEED_RANGE * 100)) / 100.0f;
-    memcpy(s->text, pkt->text, pkt->length + 1);
-    memcpy(s->colors, pkt->colors, pkt->length * sizeof(int));
-    s->text_len = pkt->length;
-    s->chars_shown = 0;
-    s->frames_alive = 0;
-    s->fade_at_frame = FADE_DELAY_MIN + (rand() % FADE_DELAY_RANGE);
+/* Another packet of a flow already on screen: keep its stream alive and
+ * speed it up a little instead of spawning a duplicate. A stream whose
+ * head already reached the bottom can only finish fading. */
+static int refresh_stream(int pos, int screen_height) {
+    if (streams.state[pos] == STREAM_FADING && streams.row[pos] >= screen_height - 1) return 0;
 
-    column_available[col] = 0;
+    streams.state[pos] = STREAM_ACTIVE;
+    if (streams.fade_at[pos] < streams.age[pos] + FADE_DELAY_MIN) {
+        streams.fade_at[pos] = streams.age[pos] + FADE_DELAY_MIN;
+    }
+    streams.speed[pos] += FLOW_REFRESH_SPEEDUP;
+    if (streams.speed[pos] > STREAM_SPEED_MAX) streams.speed[pos] = STREAM_SPEED_MAX;
+    return 1;
 }
 
-/* Initialize streams for a given screen width */
-void init_streams(int width) {
-    stream_screen_width = width;
-    memset(streams, 0, sizeof(streams));
+/* Format a record into a stream as its metadata or hex text, keeping
+ * only as much text storage as it needs */
+static void format_stream(int pos, const packet_record_t *rec, int hex) {
+    int id = streams.id[pos];
+    stream_text_t *t = &stream_text[id];
+    char text[MAX_INFO_LEN];
+    int len;
 
-    free_slot_count = MAX_STREAMS;
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        free_slots[i] = MAX_STREAMS - 1 - i;
+    if (hex) {
+        len = format_packet_hex(rec, text, &t->colors);
+    } else {
+        /* Read before formatting, so an answer landing meanwhile still
+         * triggers a refresh */
+        t->names_generation = resolve_names ? resolver_generation() : 0;
+        len = format_packet_meta(rec, text, &t->colors, &t->names_pending);
+        if (t->names_pending) {
+            pending_records[id] = *rec;
+        }
     }
 
-    free(column_available);
-    column_available = calloc(width, sizeof(int));
-    if (!column_available) {
-        fprintf(stderr, "Failed to allocate column_available\n");
-        exit(1);
+    slab_free(t->text);
+    t->text = slab_alloc(len + 1);
+    memcpy(slab_ptr(t->text), text, len + 1);
+    streams.text_len[pos] = len;
+}
+
+static void fill_stream(int pos, const packet_record_t *rec, int hex,
+                        const frame_ctx_t *frame) {
+    stream_text_t *t = &stream_text[streams.id[pos]];
+    t->origin_us = rec->captured_us ? rec->captured_us : rec->queued_us;
+    t->assigned_us = frame->now_us;
+
+    if (profiling) {
+        uint64_t start = profile_ticks();
+        format_stream(pos, rec, hex);
+        format_ticks += profile_ticks() - start;
+        format_calls++;
+    } else {
+        format_stream(pos, rec, hex);
     }
-    for (int i = 0; i < width; i++) {
-        column_available[i] = 1;
+}
+
+/* Swap in hostnames that arrived since a stream was spawned. Only called
+ * once the resolver has answered something new. */
+static void refresh_stream_names(int pos) {
+    format_stream(pos, &pending_records[streams.id[pos]], 0);
+    if (streams.chars_shown[pos] > streams.text_len[pos]) {
+        streams.chars_shown[pos] = streams.text_len[pos];
     }
 }
 
-/* Resize streams to new dimensions */
-void resize_streams(int new_width, int new_height) {
-    stream_screen_width = new_width;
-    stream_screen_height = new_height;
+/* Fold a record into its flow. Flows already on screen refresh their
+ * streams; others offer a metadata stream and, for encrypted traffic
+ * with enough payload, a hex stream for admission. Nothing spawns until
+ * the drain ends, so the whole frame's traffic competes fairly. */
+static void assign_record_to_streams(const packet_record_t *rec, void *ctx) {
+    frame_ctx_t *frame = ctx;
+    int created;
 
-    free(column_available);
-    column_available = calloc(new_width, sizeof(int));
-    if (!column_available) {
-        fprintf(stderr, "Failed to allocate column_available on resize\n");
-        exit(1);
+    if (rec->captured_us) {
+        latency_record(LATENCY_CAPTURE, rec->captured_us, rec->queued_us);
     }
-    for (int i = 0; i < new_width; i++) {
-        column_available[i] = 1;
+    latency_record(LATENCY_QUEUE, rec->queued_us, frame->now_us);
+
+    int novelty = admit_observe(rec);
+    flow_t *flow = flow_track(rec, frame->now, &created);
+    if (created) novelty |= ADMIT_NEW_FLOW;
+
+    int pos = flow_stream(flow->meta_stream, flow->meta_generation);
+    if ((pos < 0 || !refresh_stream(pos, frame->screen_height)) &&
+        flow->meta_offered != admit_frame) {
+        flow->meta_offered = admit_frame;
+        admit_offer(rec, 0, novelty);
+    }
+
+    if (rec->is_encrypted && rec->payload_len >= MIN_PACKET_DISPLAY) {
+        pos = flow_stream(flow->hex_stream, flow->hex_generation);
+        if ((pos < 0 || !refresh_stream(pos, frame->screen_height)) &&
+            flow->hex_offered != admit_frame) {
+            flow->hex_offered = admit_frame;
+            admit_offer(rec, 1, novelty);
+        }
     }
+}
+
+/* Spawn the streams admitted this frame and point their flows at them.
+ * A flow evicted since its offer still gets its stream, just unlinked.
+ * Returns how many were admitted. */
+static int spawn_admitted(const frame_ctx_t *frame) {
+    const admit_candidate_t *picked[ADMIT_RESERVOIR];
+    int n = admit_select(picked);
+
+    for (int i = 0; i < n; i++) {
+        const packet_record_t *rec = &picked[i]->rec;
+        int hex = picked[i]->hex;
+        int zone = hex ? ZONE_ENCRYPTED_HEX
+                 : rec->is_encrypted ? ZONE_ENCRYPTED_META : ZONE_CLEARTEXT;
+
+        int pos = spawn_stream(zone);
+        if (pos < 0) continue;
+        fill_stream(pos, rec, hex, frame);
 
-    /* Reset all streams on resize */
-    memset(streams, 0, sizeof(streams));
-    free_slot_count = MAX_STREAMS;
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        free_slots[i] = MAX_STREAMS - 1 - i;
+        flow_t *flow = flow_find(rec);
+        if (!flow) continue;
+        int id = streams.id[pos];
+        if (hex) {
+            flow->hex_stream = id;
+            flow->hex_generation = stream_text[id].generation;
+        } else {
+            flow->meta_stream = id;
+            flow->meta_generation = stream_text[id].generation;
+        }
     }
+    return n;
+}
+
+void streams_seed(uint64_t seed) {
+    prng_seed(&stream_rng, seed);
+    columns_seed(prng_next(&stream_rng));
+    admit_seed(prng_next(&stream_rng));
+}
+
+/* Initialize streams for a given screen width */
+void init_streams(int width) {
+    stream_screen_width = width;
+    alloc_streams(width);
+}
+
+/* Resize streams to new dimensions (all streams are dropped) */
+void resize_streams(int new_width, int new_height) {
+    stream_screen_width = new_width;
+    stream_screen_height = new_height;
+    alloc_streams(new_width);
 }
 
 /* Update all streams */
-void update_streams(int screen_height, unsigned long frame_count) {
-    packet_t pkt;
-    int packets_this_frame = 0;
+void update_streams(int screen_height) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    frame_ctx_t frame = {
+        .now = ts.tv_sec + ts.tv_nsec / 1e9,
+        .now_us = latency_now_us(),
+        .screen_height = screen_height,
+    };
 
-    while (ring_buffer_pop(&ring_buffer, &pkt) == 0 && packets_this_frame < PACKETS_PER_FRAME) {
-        assign_packet_to_stream(&pkt);
-        packets_this_frame++;
+    /* A simulation runs on the replay's timeline: only records stamped up
+     * to the frame clock are due, and flows age by it */
+    uint64_t until_us = UINT64_MAX;
+    if (simulation) {
+        until_us = frame.now_us;
+        frame.now = frame.now_us / 1e6;
     }
 
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        stream_t *s = &streams[i];
+    /* Streams move by the time since the last update, not per frame, so
+     * the frame rate changes smoothness rather than speed */
+    stream_clock = frame.now;
+    float dt = last_update > 0 ? (float)(frame.now - last_update) : 0.0f;
+    if (dt < 0) dt = 0;
+    if (dt > STREAM_MAX_STEP) dt = STREAM_MAX_STEP;
+    last_update = frame.now;
+
+    /* The spawn budget accrues per second too, so faster frames each
+     * admit fewer streams rather than more in total */
+    spawn_credit += STREAMS_PER_SECOND * dt;
+    if (spawn_credit > PACKETS_PER_FRAME) spawn_credit = PACKETS_PER_FRAME;
 
-        if (s->state == STREAM_EMPTY) continue;
+    /* Every record updates its flow; the admitted ones then spawn */
+    admit_begin(frame.now, (int)spawn_credit);
+    capture_drain(assign_record_to_streams, &frame, RECORDS_PER_FRAME, until_us);
+    spawn_credit -= spawn_admitted(&frame);
+    flow_expire(frame.now);
 
-        if (s->state == STREAM_ACTIVE) {
-            s->row += s->speed;
-            s->frames_alive++;
+    /* Motion: branch-free over the packed arrays, so it vectorizes */
+    int n = stream_count;
+    for (int i = 0; i < n; i++) {
+        float step = streams.state[i] == STREAM_ACTIVE ? dt : 0.0f;
+        streams.row[i] += streams.speed[i] * step;
+        streams.age[i] += step;
+    }
+
+    /* Streams showing addresses are re-formatted once the resolver has
+     * answered anything since they were formatted */
+    unsigned int names_generation = resolve_names ? resolver_generation() : 0;
+
+    /* State changes; a removal moves the last stream into position i */
+    for (int i = 0; i < stream_count; ) {
+        const stream_text_t *t = &stream_text[streams.id[i]];
+        if (t->names_pending && t->names_generation != names_generation) {
+            refresh_stream_names(i);
+        }
 
-            int effective_len = s->text_len < MAX_STREAM_LENGTH ? s->text_len : MAX_STREAM_LENGTH;
-            int new_chars_shown = (int)s->row;
+        if (streams.state[i] == STREAM_ACTIVE) {
+            int text_len = streams.text_len[i];
+            int effective_len = text_len < MAX_STREAM_LENGTH ? text_len : MAX_STREAM_LENGTH;
+            int new_chars_shown = (int)streams.row[i];
             if (new_chars_shown > effective_len) {
                 new_chars_shown = effective_len;
             }
 
-            s->chars_shown = new_chars_shown;
+            streams.chars_shown[i] = new_chars_shown;
 
-            int tail_row = (int)s->row - s->chars_shown;
-            if (tail_row > screen_height || s->frames_alive >= s->fade_at_frame) {
-                s->state = STREAM_FADING;
-                if (s->row >= screen_height) {
-                    s->chars_shown -= (int)s->row - (screen_height - 1);
-                    s->row = screen_height - 1;
-                    if (s->chars_shown < 1) s->chars_shown = 1;
+            int tail_row = (int)streams.row[i] - new_chars_shown;
+            if (tail_row > screen_height || streams.age[i] >= streams.fade_at[i]) {
+                streams.state[i] = STREAM_FADING;
+                if (streams.row[i] >= screen_height) {
+                    streams.chars_shown[i] -= (int)streams.row[i] - (screen_height - 1);
+                    streams.row[i] = screen_height - 1;
+                    if (streams.chars_shown[i] < 1) streams.chars_shown[i] = 1;
                 }
             }
-        } else if (s->state == STREAM_FADING) {
-            s->chars_shown -= FADE_RATE;
-            if (s->chars_shown <= 0) {
-                column_available[s->column] = 1;
-                s->state = STREAM_EMPTY;
-                if (free_slot_count < MAX_STREAMS) {
-                    free_slots[free_slot_count++] = i;
-                }
+        } else {
+            streams.chars_shown[i] -= FADE_RATE * dt;
+            if (streams.chars_shown[i] < 1) {   /* nothing left to draw */
+                remove_stream(i);
+                continue;
             }
         }
+        i++;
     }
 
-    update_network_rate(frame_count);
+    capture_update_rates();
+}
+
+/* Streams count as displayed once a committed frame draws a character */
+void streams_presented(void) {
+    uint64_t now_us = latency_now_us();
+
+    for (int i = 0; i < stream_count; i++) {
+        stream_text_t *t = &stream_text[streams.id[i]];
+        if (t->shown || streams.chars_shown[i] < 1) continue;
+
+        latency_record(LATENCY_DISPLAY, t->assigned_us, now_us);
+        latency_record(LATENCY_TOTAL, t->origin_us, now_us);
+        t->shown = 1;
+    }
+}
+
+/* Print the formatter's cost per stream (only meaningful with --profile) */
+void streams_print_profile(void) {
+    if (format_calls == 0) return;
+    printf("format: %.1f %s/stream (hex kernel: %s)\n",
+           (double)format_ticks / format_calls, PROFILE_UNIT, format_hex_kernel());
+    printf("stream text: %zu KB in use, %zu KB reserved\n",
+           slab_bytes_used() / 1024, slab_bytes_reserved() / 1024);
 }
 
 /* Returns 1 if any stream is active or fading */
 int streams_have_content(void) {
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        if (streams[i].state != STREAM_EMPTY)
-            return 1;
-    }
-    return 0;
+    return stream_count > 0;
 }
@@ -2,44 +2,74 @@
 #define STREAMS_H
 
 #include "capture.h"
+#include "format.h"
+#include "slab.h"
 
-/* Configuration */
-#define MAX_STREAMS        512
+/* Configuration. Motion is in seconds, so it looks the same at any
+ * frame rate. */
 #define MAX_STREAM_LENGTH  160
-#define STREAM_SPEED_MIN   0.4f
-#define STREAM_SPEED_RANGE 1.5f
-#define FADE_DELAY_MIN     30
-#define FADE_DELAY_RANGE   120
-#define FADE_RATE          2
+#define STREAM_SPEED_MIN   4.0f    /* rows per second */
+#define STREAM_SPEED_RANGE 15.0f
+#define FADE_DELAY_MIN     3.0f    /* seconds before a stream fades */
+#define FADE_DELAY_RANGE   12.0f
+#define FADE_RATE          20.0f   /* characters removed per second */
 #define TRAIL_DIM_DISTANCE 15
-#define BLINK_CYCLE        6
-#define BLINK_ON           3
-#define COLUMN_GAP         1
-#define PACKETS_PER_FRAME  20
-#define COLUMN_SEARCH_ATTEMPTS 40
+#define BLINK_CYCLE        0.6f    /* seconds per head blink */
+#define BLINK_ON           0.3f    /* of which the head is lit */
+#define STREAM_MAX_STEP    0.25f   /* longest step one update takes, so a
+                                      stall doesn't make streams jump */
+#define STREAMS_PER_SECOND 200.0f /* new streams admitted, spread over frames */
+#define PACKETS_PER_FRAME  20    /* most new streams spawned in one frame */
+#define RECORDS_PER_FRAME  4096  /* records drained per frame */
+#define STREAM_SPEED_MAX   40.0f
+#define FLOW_REFRESH_SPEEDUP 1.0f /* rows/second added per packet of a shown flow */
 
 /* Stream states */
-#define STREAM_EMPTY     0
 #define STREAM_ACTIVE    1
 #define STREAM_FADING    2
 
+/* Per-frame stream state as parallel arrays, with the live streams packed
+ * into [0, stream_count) so the update and draw loops touch nothing else.
+ * Removing a stream moves the last one into its place: positions change,
+ * a stream's id (its index into stream_text) does not. */
 typedef struct {
-    int state;
-    int column;
-    float row;
-    float speed;
-    char text[MAX_INFO_LEN];
-    int colors[MAX_INFO_LEN];
-    int text_len;
-    int chars_shown;
-    int frames_alive;
-    int fade_at_frame;
-} stream_t;
+    int *id;
+    int *state;              /* STREAM_ACTIVE or STREAM_FADING */
+    int *column;
+    float *row;              /* head position; fractions draw between cells */
+    float *speed;            /* rows per second */
+    int *text_len;
+    float *chars_shown;      /* fractional while fading */
+    float *age;              /* seconds spent active */
+    float *fade_at;          /* age at which it starts fading */
+} stream_table_t;
+
+/* The rest of a stream, by id: only formatting and drawing read it */
+typedef struct {
+    slab_handle_t text;      /* NUL-terminated, in the smallest chunk that fits */
+    color_spans_t colors;
+    unsigned int generation; /* bumped on every spawn, so flows can tell
+                                their stream was recycled */
+    int names_pending;       /* showing addresses until --names has them */
+    unsigned int names_generation;  /* resolver_generation() when formatted */
+    uint64_t origin_us;      /* when its packet was captured (or queued) */
+    uint64_t assigned_us;    /* when the frame loop spawned it */
+    int shown;               /* a committed frame has shown it */
+} stream_text_t;
 
 /* Globals (defined in streams.c) */
-extern stream_t streams[MAX_STREAMS];
+extern stream_table_t streams;
+extern stream_text_t *stream_text;
+extern int stream_count;
+extern int stream_capacity;
 extern int stream_screen_width;
 extern int stream_screen_height;
+extern double stream_clock;   /* seconds at the last update (simulated in a
+                                 simulation), for time-based effects */
+
+/* Seed the stream, column and admission generators; the same seed and input give
+ * the same streams */
+void streams_seed(uint64_t seed);
 
 /* Initialize streams for a given screen width */
 void init_streams(int width);
@@ -47,8 +77,15 @@ void init_streams(int width);
 /* Resize streams to new dimensions */
 void resize_streams(int new_width, int new_height);
 
-/* Update all streams (pop from ring buffer, advance positions) */
-void update_streams(int screen_height, unsigned long frame_count);
+/* Update all streams (drain the rings into flows, advance positions) */
+void update_streams(int screen_height);
+
+/* A frame was committed: record display latency for streams it shows
+ * for the first time */
+void streams_presented(void);
+
+/* Print per-stream formatting cost gathered under --profile */
+void streams_print_profile(void);
 
 /* Returns 1 if any stream is active or fading */
 int streams_have_content(void);